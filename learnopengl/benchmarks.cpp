@@ -0,0 +1,1120 @@
+#include "benchmarks.h"
+#include "bvh.h"
+#include "culling.h"
+#include "drawmatrices.h"
+#include "glstate.h"
+#include "gpuculling.h"
+#include "indexoptimizer.h"
+#include "meshcache.h"
+#include "modelloader.h"
+#include "occlusion.h"
+#include "renderqueue.h"
+#include "scene.h"
+#include "threadpool.h"
+#include "transformhierarchy.h"
+#include "vertexformat.h"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <array>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+struct FrameTiming {
+	double cpuMilliseconds;
+	double frameMilliseconds;
+	unsigned long long draws;
+};
+
+// Runs frame() for a number of frames, timing the CPU side (recording the frame) and the whole
+// frame including the GPU (glFinish).
+static FrameTiming measureFrames(GLFWwindow* window, int frames, const std::function<void()>& frame)
+{
+	using clock = std::chrono::steady_clock;
+
+	// one frame outside the measurement to upload buffers and settle the driver
+	frame();
+	glFinish();
+	glState.resetCounters();
+
+	double cpu = 0.0;
+	double total = 0.0;
+	for (int i = 0; i < frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		clock::time_point start = clock::now();
+		frame();
+		clock::time_point recorded = clock::now();
+		glFinish();
+		clock::time_point finished = clock::now();
+
+		cpu += std::chrono::duration<double, std::milli>(recorded - start).count();
+		total += std::chrono::duration<double, std::milli>(finished - start).count();
+
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+	}
+
+	return FrameTiming{ cpu / frames, total / frames, glState.getCounters().draws / frames };
+}
+
+// Average milliseconds per call of work() over a number of runs.
+static double measureMilliseconds(int runs, const std::function<void()>& work)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+		work();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count() / runs;
+}
+
+static void printTiming(const char* label, const FrameTiming& timing)
+{
+	std::cout << "  " << label << ": " << timing.draws << " draws/frame, "
+		<< timing.cpuMilliseconds << " ms CPU, " << timing.frameMilliseconds << " ms frame" << std::endl;
+}
+
+// ---------------------------------------------------------------------------------------------- Instancing
+const int GRID_SIZE = 100;
+const int GRID_FRAMES = 100;
+
+// GRID_SIZE x GRID_SIZE half scale copies on the ground plane, with a camera above seeing all of them.
+static std::vector<glm::mat4> gridMatrices()
+{
+	const float SPACING = 2.5f;
+
+	std::vector<glm::mat4> matrices;
+	matrices.reserve(GRID_SIZE * GRID_SIZE);
+	for (int x = 0; x < GRID_SIZE; x++) {
+		for (int z = 0; z < GRID_SIZE; z++) {
+			glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3((x - GRID_SIZE / 2) * SPACING, 0.0f, (z - GRID_SIZE / 2) * SPACING));
+			matrices.push_back(glm::scale(matrix, glm::vec3(0.5f)));
+		}
+	}
+	return matrices;
+}
+
+static FrameBlock gridFrame(GLFWwindow* window)
+{
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+
+	FrameBlock frame {};
+	frame.viewPos = glm::vec3(0.0f, 80.0f, 160.0f);
+	frame.view = glm::lookAt(frame.viewPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frame.projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 500.0f);
+	frame.viewProjection = frame.projection * frame.view;
+	return frame;
+}
+
+void runInstancingBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& shader, Shader& instancedShader)
+{
+	std::vector<glm::mat4> matrices = gridMatrices();
+	FrameBlock frame = gridFrame(window);
+	frameUBO.update(frame);
+
+	RenderQueue queue;
+	FrameTiming perObject = measureFrames(window, GRID_FRAMES, [&] {
+		queue.begin(frame.view, frame.projection, 0.1f, 500.0f);
+		for (const glm::mat4& matrix : matrices)
+			model.Submit(queue, shader, matrix);
+		queue.execute();
+	});
+
+	FrameTiming instanced = measureFrames(window, GRID_FRAMES, [&] {
+		model.DrawInstanced(instancedShader, matrices);
+	});
+
+	std::cout << "BENCHMARK: " << matrices.size() << " instances" << std::endl;
+	printTiming("per object", perObject);
+	printTiming("instanced ", instanced);
+}
+
+// ---------------------------------------------------------------------------------------------- Multi Draw
+// Renders one frame and reads back the colour buffer.
+static std::vector<unsigned char> readFrame(GLFWwindow* window, const std::function<void()>& frame)
+{
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	frame();
+
+	std::vector<unsigned char> pixels((size_t)width * height * 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	return pixels;
+}
+
+bool runMultiDrawBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& shader, Shader* multiDrawShader)
+{
+	std::vector<glm::mat4> matrices = gridMatrices();
+	FrameBlock frame = gridFrame(window);
+	frameUBO.update(frame);
+
+	RenderQueue queue;
+	if (multiDrawShader)
+		queue.setMultiDrawVariant(shader, *multiDrawShader);
+
+	auto render = [&] {
+		queue.begin(frame.view, frame.projection, 0.1f, 500.0f);
+		for (const glm::mat4& matrix : matrices)
+			model.Submit(queue, shader, matrix);
+		queue.execute();
+	};
+
+	queue.setMultiDraw(false);
+	FrameTiming perMesh = measureFrames(window, GRID_FRAMES, render);
+	std::vector<unsigned char> perMeshPixels = readFrame(window, render);
+
+	std::cout << "BENCHMARK: " << matrices.size() << " objects, " << model.meshCount() << " meshes each" << std::endl;
+	printTiming("per mesh  ", perMesh);
+
+	queue.setMultiDraw(true);
+	if (!queue.isMultiDrawActive()) {
+		std::cout << "  multi draw: not supported by this context, only the GL 3.3 path ran" << std::endl;
+		return true;
+	}
+
+	FrameTiming multiDraw = measureFrames(window, GRID_FRAMES, render);
+	std::vector<unsigned char> multiDrawPixels = readFrame(window, render);
+	printTiming("multi draw", multiDraw);
+
+	// the same matrices go through the same arithmetic on either path, only rounding may differ
+	size_t differing = 0;
+	for (size_t i = 0; i < perMeshPixels.size(); i++) {
+		if (std::abs((int)perMeshPixels[i] - (int)multiDrawPixels[i]) > 2)
+			differing++;
+	}
+	std::cout << "  " << differing << " of " << perMeshPixels.size() << " channels differ between the paths" << std::endl;
+
+	return differing * 1000 <= perMeshPixels.size();
+}
+
+// ---------------------------------------------------------------------------------------------- Vertex Transform
+// model_loading.vert as it was before DrawMatrices: every vertex inverts its model matrix and
+// multiplies projection, view and model together.
+static const char* PER_VERTEX_MATRICES_SHADER = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+layout (std140) uniform Frame {
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	mat4 viewProjection;
+};
+
+uniform mat4 model;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out vec3 Normal;
+
+void main()
+{
+	TexCoords = aTexCoords;
+	FragPos = vec3(model * vec4(aPos, 1.0));
+	Normal = mat3(transpose(inverse(model))) * aNormal;
+	gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
+)";
+
+const int VERTEX_COPIES = 1000;
+const int VERTEX_FRAMES = 20;
+
+bool runVertexTransformBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& shader)
+{
+	std::vector<glm::mat4> matrices = gridMatrices();
+	FrameBlock frame = gridFrame(window);
+	frameUBO.update(frame);
+
+	// ------------------------------------------| CPU
+	std::vector<glm::mat4> locals(matrices.size());
+	for (size_t i = 0; i < locals.size(); i++)
+		locals[i] = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, -1.0f, 2.0f)), glm::vec3(3.0f, 0.25f, 1.5f + i % 7));
+
+	std::vector<DrawMatrices> reference(matrices.size());
+	double scalar = measureMilliseconds(GRID_FRAMES, [&] {
+		for (size_t i = 0; i < matrices.size(); i++) {
+			reference[i].model = matrices[i] * locals[i];
+			reference[i].normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(matrices[i]))));
+			reference[i].modelViewProjection = frame.projection * frame.view * reference[i].model;
+		}
+	});
+
+	std::vector<DrawMatrices> batched(matrices.size());
+	double simd = measureMilliseconds(GRID_FRAMES, [&] {
+		computeDrawMatrices(frame.viewProjection, matrices.data(), locals.data(), matrices.size(), batched.data());
+	});
+
+	float largestError = 0.0f;
+	for (size_t i = 0; i < matrices.size(); i++) {
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				largestError = std::max(largestError, std::abs(batched[i].model[column][row] - reference[i].model[column][row]));
+				largestError = std::max(largestError, std::abs(batched[i].normalMatrix[column][row] - reference[i].normalMatrix[column][row]));
+				largestError = std::max(largestError, std::abs(batched[i].modelViewProjection[column][row] - reference[i].modelViewProjection[column][row]));
+			}
+		}
+	}
+
+	std::cout << "BENCHMARK: draw matrices for " << matrices.size() << " draws" << std::endl;
+	std::cout << "  glm one by one: " << scalar << " ms" << std::endl;
+	std::cout << "  batched:        " << simd << " ms" << std::endl;
+	std::cout << "  largest difference: " << largestError << std::endl;
+
+	// ------------------------------------------| GPU
+	// rasterizer discard leaves only the vertex work, which is what the two shaders differ in
+	ShaderSource perVertexSource = ShaderSource::fromFiles("resources/shaders/model_loading.vert", "resources/shaders/model_loading.frag");
+	perVertexSource.name = "per-vertex matrices";
+	perVertexSource.vertexCode = PER_VERTEX_MATRICES_SHADER;
+	Shader perVertexShader(perVertexSource, { { "NR_POINT_LIGHTS", "1" } });
+	perVertexShader.wait();
+
+	matrices.resize(VERTEX_COPIES);
+	glEnable(GL_RASTERIZER_DISCARD);
+	FrameTiming perVertex = measureFrames(window, VERTEX_FRAMES, [&] {
+		for (const glm::mat4& matrix : matrices)
+			model.Draw(perVertexShader, matrix, frame.viewProjection);
+	});
+	FrameTiming perDraw = measureFrames(window, VERTEX_FRAMES, [&] {
+		for (const glm::mat4& matrix : matrices)
+			model.Draw(shader, matrix, frame.viewProjection);
+	});
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	std::cout << "BENCHMARK: vertex shading of " << matrices.size() << " copies, rasterizer discarded" << std::endl;
+	printTiming("per vertex", perVertex);
+	printTiming("per draw  ", perDraw);
+
+	// a few ulps, the batched products only add in a different order
+	return largestError < 1e-3f;
+}
+
+// ---------------------------------------------------------------------------------------------- Culling
+void runCullingBenchmark()
+{
+	const int RUNS = 50;
+	const int COUNTS[] = { 1000, 10000, 100000 };
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = Frustum::fromMatrix(projection * view);
+
+	std::cout << "BENCHMARK: frustum culling, ms per frame" << std::endl;
+	for (int count : COUNTS) {
+		// constant density, so the visible fraction stays about the same as the scene grows
+		float halfSize = 10.0f * std::cbrt((float)count);
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-halfSize, halfSize);
+		std::uniform_real_distribution<float> size(0.5f, 2.0f);
+
+		std::vector<AABB> boxes(count);
+		for (AABB& box : boxes) {
+			glm::vec3 center(position(random), position(random), position(random));
+			glm::vec3 extents(size(random));
+			box = AABB(center - extents, center + extents);
+		}
+
+		FrustumCuller culler;
+		for (const AABB& box : boxes)
+			culler.add(box);
+
+		std::vector<uint8_t> flatVisible;
+		size_t flatCount = 0;
+		double flat = measureMilliseconds(RUNS, [&] { flatCount = culler.cull(frustum, flatVisible); });
+
+		BVH bvh;
+		double build = measureMilliseconds(1, [&] { bvh.build(boxes); });
+
+		std::vector<int> bvhVisible;
+		double hierarchical = measureMilliseconds(RUNS, [&] {
+			bvhVisible.clear();
+			bvh.cull(frustum, bvhVisible);
+		});
+
+		// a tenth of the scene moving every frame
+		double refit = measureMilliseconds(RUNS, [&] {
+			for (int i = 0; i < count; i += 10) {
+				boxes[i].min.y += 0.01f;
+				boxes[i].max.y += 0.01f;
+				bvh.update(i, boxes[i]);
+			}
+			bvh.refit();
+		});
+
+		std::cout << "  " << count << " boxes, " << flatCount << " visible (bvh " << bvhVisible.size() << "): flat " << flat
+			<< ", bvh " << hierarchical << ", bvh build " << build << ", 10% refit " << refit << std::endl;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- Occlusion
+// Axis aligned box as occluder geometry, two triangles per face.
+static void appendBox(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	unsigned int first = (unsigned int)vertices.size();
+	for (int corner = 0; corner < 8; corner++) {
+		Vertex vertex {};
+		vertex.Position = glm::vec3((corner & 1) ? maximum.x : minimum.x, (corner & 2) ? maximum.y : minimum.y, (corner & 4) ? maximum.z : minimum.z);
+		vertices.push_back(vertex);
+	}
+
+	const unsigned int faces[] = {
+		0, 2, 3, 0, 3, 1,	4, 5, 7, 4, 7, 6,
+		0, 1, 5, 0, 5, 4,	2, 6, 7, 2, 7, 3,
+		0, 4, 6, 0, 6, 2,	1, 3, 7, 1, 7, 5
+	};
+	for (unsigned int index : faces)
+		indices.push_back(first + index);
+}
+
+static AABB cubeAt(const glm::vec3& center, float halfSize)
+{
+	return AABB(center - glm::vec3(halfSize), center + glm::vec3(halfSize));
+}
+
+// A grid of buildings in front of a camera at the origin looking down -z.
+static void appendCity(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	for (int x = -10; x <= 10; x++) {
+		for (int z = 1; z <= 20; z++) {
+			glm::vec3 base(x * 6.0f, -2.0f, -z * 6.0f);
+			appendBox(vertices, indices, base - glm::vec3(2.0f, 0.0f, 2.0f), base + glm::vec3(2.0f, 4.0f + (x * z % 5), 2.0f));
+		}
+	}
+}
+
+bool runOcclusionBenchmark()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)OCCLUSION_WIDTH / (float)OCCLUSION_HEIGHT, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	OcclusionCuller occlusion;
+
+	// ------------------------------------------| Accuracy
+	// A wall covering the lower half of the view five units away. Cubes behind it must be hidden,
+	// cubes above its top edge or in front of it must stay visible.
+	std::vector<Vertex> wallVertices;
+	std::vector<unsigned int> wallIndices;
+	appendBox(wallVertices, wallIndices, glm::vec3(-20.0f, -20.0f, -5.2f), glm::vec3(20.0f, 0.0f, -5.0f));
+
+	occlusion.begin(projection * view);
+	occlusion.addOccluder(wallVertices, wallIndices, glm::mat4(1.0f));
+	occlusion.render();
+
+	int wrong = 0;
+	int checked = 0;
+	for (int i = -4; i <= 4; i++) {
+		float x = i * 1.5f;
+		wrong += occlusion.isVisible(cubeAt(glm::vec3(x, -2.5f, -10.0f), 0.25f)) ? 1 : 0;		// behind the wall
+		wrong += occlusion.isVisible(cubeAt(glm::vec3(x, 2.5f, -10.0f), 0.25f)) ? 0 : 1;		// above it
+		wrong += occlusion.isVisible(cubeAt(glm::vec3(x * 0.3f, -0.5f, -3.0f), 0.25f)) ? 0 : 1;	// in front of it
+		wrong += occlusion.isVisible(cubeAt(glm::vec3(x, 0.1f, -10.0f), 0.25f)) ? 0 : 1;		// peeking over the edge
+		checked += 4;
+	}
+	// crossing the near plane
+	wrong += occlusion.isVisible(cubeAt(glm::vec3(0.0f, -0.5f, 0.0f), 0.5f)) ? 0 : 1;
+	checked++;
+
+	std::cout << "BENCHMARK: occlusion culling" << std::endl;
+	std::cout << "  known scene: " << checked - wrong << "/" << checked << " correct" << std::endl;
+
+	// ------------------------------------------| Timing
+	// A city block: a grid of buildings as occluders and scattered cubes tested behind them.
+	std::vector<Vertex> cityVertices;
+	std::vector<unsigned int> cityIndices;
+	appendCity(cityVertices, cityIndices);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> distance(-120.0f, -2.0f);
+	std::vector<AABB> boxes(10000);
+	for (AABB& box : boxes)
+		box = cubeAt(glm::vec3(spread(random), spread(random) * 0.05f, distance(random)), 0.5f);
+
+	const int RUNS = 50;
+	double raster = measureMilliseconds(RUNS, [&] {
+		occlusion.begin(projection * view);
+		occlusion.addOccluder(cityVertices, cityIndices, glm::mat4(1.0f));
+		occlusion.render();
+	});
+
+	size_t visibleCount = 0;
+	double queries = measureMilliseconds(RUNS, [&] {
+		visibleCount = 0;
+		for (const AABB& box : boxes)
+			visibleCount += occlusion.isVisible(box);
+	});
+
+	std::cout << "  city: " << occlusion.triangleCount() << " occluder triangles in " << raster << " ms on "
+		<< workerPool().size() + 1 << " threads" << std::endl;
+	std::cout << "  " << boxes.size() << " box queries in " << queries << " ms, " << boxes.size() - visibleCount << " occluded" << std::endl;
+
+	return wrong == 0;
+}
+
+// ---------------------------------------------------------------------------------------------- GPU Culling
+// Visible on one side and culled on the other is only allowed for boxes touching a plane, where the
+// two sides round differently.
+static bool onFrustumEdge(const Frustum& frustum, const AABB& box)
+{
+	glm::vec3 center = box.center();
+	glm::vec3 extents = box.extents();
+	for (const glm::vec4& plane : frustum.planes) {
+		glm::vec3 normal = glm::vec3(plane);
+		float distance = glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extents);
+		float scale = std::fabs(plane.w) + glm::dot(glm::abs(normal), glm::abs(center) + extents);
+		if (std::fabs(distance) <= scale * 1e-5f)
+			return true;
+	}
+	return false;
+}
+
+bool runGpuCullingBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& instancedShader)
+{
+	const size_t INSTANCES = 131072;
+	const int RUNS = 20;
+
+	// the model scattered through the city from the occlusion benchmark, about a unit across
+	float scale = 1.0f / std::max(glm::length(model.getBounds().extents()), 1e-3f);
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> elevation(-2.0f, 6.0f);
+	std::uniform_real_distribution<float> distance(-130.0f, 10.0f);
+	std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+
+	std::vector<glm::mat4> matrices(INSTANCES);
+	std::vector<AABB> boxes(INSTANCES);
+	for (size_t i = 0; i < INSTANCES; i++) {
+		glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(spread(random), elevation(random), distance(random)));
+		matrix = glm::rotate(matrix, angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+		matrices[i] = glm::scale(matrix, glm::vec3(scale));
+		boxes[i] = model.getBounds().transformed(matrices[i]);
+	}
+
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+
+	FrameBlock frame {};
+	frame.viewPos = glm::vec3(0.0f);
+	frame.view = glm::lookAt(frame.viewPos, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frame.projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+	frame.viewProjection = frame.projection * frame.view;
+	frameUBO.update(frame);
+	glm::mat4 viewProjection = frame.viewProjection;
+	Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+	GpuCuller gpu;
+	gpu.setInstances(model, matrices);
+
+	std::cout << "BENCHMARK: GPU culling, " << INSTANCES << " instances" << std::endl;
+
+	// ------------------------------------------| Frustum
+	FrustumCuller culler;
+	for (const AABB& box : boxes)
+		culler.add(box);
+
+	std::vector<uint8_t> cpuVisible;
+	size_t cpuCount = 0;
+	double cpuFrustum = measureMilliseconds(RUNS, [&] { cpuCount = culler.cull(frustum, cpuVisible); });
+
+	gpu.setOcclusion(NULL);
+	double gpuFrustum = measureMilliseconds(RUNS, [&] {
+		gpu.cull(model, viewProjection);
+		glFinish();
+	});
+	std::vector<uint8_t> gpuVisible = gpu.readVisibility();
+	size_t gpuCount = gpu.readVisibleCount();
+
+	size_t differing = 0;
+	size_t wrong = 0;
+	for (size_t i = 0; i < INSTANCES; i++) {
+		if (gpuVisible[i] != cpuVisible[i]) {
+			differing++;
+			wrong += onFrustumEdge(frustum, boxes[i]) ? 0 : 1;
+		}
+	}
+	size_t flagged = std::count(gpuVisible.begin(), gpuVisible.end(), 1);
+
+	std::cout << "  frustum: CPU " << cpuCount << " visible in " << cpuFrustum << " ms, GPU " << gpuCount << " visible in "
+		<< gpuFrustum << " ms, " << differing << " differ (" << wrong << " away from a plane)" << std::endl;
+
+	// ------------------------------------------| Hi-Z
+	std::vector<Vertex> cityVertices;
+	std::vector<unsigned int> cityIndices;
+	appendCity(cityVertices, cityIndices);
+
+	OcclusionCuller occlusion;
+	occlusion.begin(viewProjection);
+	occlusion.addOccluder(cityVertices, cityIndices, glm::mat4(1.0f));
+	occlusion.render();
+
+	size_t cpuOccluded = 0;
+	double cpuOcclusion = measureMilliseconds(RUNS, [&] {
+		cpuOccluded = 0;
+		for (size_t i = 0; i < INSTANCES; i++) {
+			if (cpuVisible[i] && !occlusion.isVisible(boxes[i]))
+				cpuOccluded++;
+		}
+	});
+
+	gpu.setOcclusion(&occlusion);
+	double gpuOcclusion = measureMilliseconds(RUNS, [&] {
+		gpu.cull(model, viewProjection);
+		glFinish();
+	});
+	std::vector<uint8_t> gpuUnoccluded = gpu.readVisibility();
+
+	// the shader tests the CPU's pixel rect against the farthest depth over a superset of its pixels, so
+	// it may keep more but never hide more
+	size_t gpuOccluded = 0;
+	size_t overCulled = 0;
+	for (size_t i = 0; i < INSTANCES; i++) {
+		if (gpuVisible[i] && !gpuUnoccluded[i]) {
+			gpuOccluded++;
+			overCulled += occlusion.isVisible(boxes[i]) ? 1 : 0;
+		}
+	}
+
+	std::cout << "  hi-z: CPU " << cpuOccluded << " occluded in " << cpuFrustum + cpuOcclusion << " ms with frustum, GPU "
+		<< gpuOccluded << " occluded in " << gpuOcclusion << " ms, " << overCulled << " hidden by the GPU only" << std::endl;
+
+	// ------------------------------------------| Frames
+	std::vector<glm::mat4> visibleMatrices;
+	FrameTiming cpuFrames = measureFrames(window, GRID_FRAMES, [&] {
+		culler.cull(frustum, cpuVisible);
+		visibleMatrices.clear();
+		for (size_t i = 0; i < INSTANCES; i++) {
+			if (cpuVisible[i] && occlusion.isVisible(boxes[i]))
+				visibleMatrices.push_back(matrices[i]);
+		}
+		model.DrawInstanced(instancedShader, visibleMatrices);
+	});
+
+	FrameTiming gpuFrames = measureFrames(window, GRID_FRAMES, [&] {
+		gpu.cull(model, viewProjection);
+		gpu.draw(model, instancedShader);
+	});
+
+	printTiming("CPU culled", cpuFrames);
+	printTiming("GPU culled", gpuFrames);
+
+	return wrong == 0 && flagged == gpuCount && overCulled == 0;
+}
+
+// ---------------------------------------------------------------------------------------------- Mesh Cache
+static bool sameMeshes(const std::vector<MeshData>& a, const std::vector<MeshData>& b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].vertices.size() != b[i].vertices.size() || a[i].indices.size() != b[i].indices.size()
+			|| a[i].materialTextures.size() != b[i].materialTextures.size() || a[i].transparent != b[i].transparent || a[i].node != b[i].node)
+			return false;
+		if (std::memcmp(a[i].vertices.data(), b[i].vertices.data(), a[i].vertices.size() * sizeof(Vertex)) != 0
+			|| std::memcmp(a[i].indices.data(), b[i].indices.data(), a[i].indices.size() * sizeof(unsigned int)) != 0)
+			return false;
+		for (size_t t = 0; t < a[i].materialTextures.size(); t++) {
+			if (a[i].materialTextures[t].path != b[i].materialTextures[t].path || a[i].materialTextures[t].type != b[i].materialTextures[t].type)
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool sameNodes(const TransformHierarchy& a, const TransformHierarchy& b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (int i = 0; i < (int)a.size(); i++) {
+		if (a.getParent(i) != b.getParent(i) || a.getName(i) != b.getName(i) || a.getLocal(i) != b.getLocal(i))
+			return false;
+	}
+	return true;
+}
+
+bool runMeshCacheBenchmark()
+{
+	const char* MODELS[] = { "resources/models/backpack/backpack.obj", "resources/models/drone_obj/drone.obj" };
+	const int RUNS = 5;
+	bool matching = true;
+
+	std::cout << "BENCHMARK: mesh cache" << std::endl;
+	for (const char* path : MODELS) {
+		std::vector<MeshData> imported;
+		TransformHierarchy importedNodes;
+		std::vector<std::string> dependencies;
+		bool ok = true;
+		double import = measureMilliseconds(1, [&] { ok = Model::importMeshes(path, imported, NULL, &importedNodes, &dependencies); });
+		if (!ok) {
+			matching = false;
+			continue;
+		}
+
+		std::string cachePath = MeshCache::pathFor(path);
+		uint64_t sourceHash = 0;
+		double hash = measureMilliseconds(1, [&] { sourceHash = MeshCache::hashSource(path); });
+		MeshCache::save(cachePath, sourceHash, MODEL_IMPORT_FLAGS, imported, importedNodes, dependencies);
+
+		std::vector<MeshData> cached;
+		TransformHierarchy cachedNodes;
+		bool hit = false;
+		double load = measureMilliseconds(RUNS, [&] { hit = MeshCache::load(cachePath, sourceHash, MODEL_IMPORT_FLAGS, cached, cachedNodes); });
+
+		bool same = hit && sameMeshes(imported, cached) && sameNodes(importedNodes, cachedNodes);
+		matching = matching && same;
+
+		std::cout << "  " << path << ": assimp " << import << " ms, cache " << load << " ms + source hash " << hash
+			<< " ms (" << import / (load + hash) << "x), " << (same ? "identical" : "MISMATCH") << ", " << dependencies.size() << " dependencies" << std::endl;
+
+		// a dependency edited after the save, standing in for the .mtl, has to turn the hit into a miss
+		std::string standIn = cachePath + ".dependency";
+		std::ofstream(standIn, std::ios::binary) << "newmtl before";
+		std::vector<std::string> withStandIn = dependencies;
+		withStandIn.push_back(standIn);
+		MeshCache::save(cachePath, sourceHash, MODEL_IMPORT_FLAGS, imported, importedNodes, withStandIn);
+		bool hitBefore = MeshCache::load(cachePath, sourceHash, MODEL_IMPORT_FLAGS, cached, cachedNodes);
+		std::ofstream(standIn, std::ios::binary) << "newmtl after";
+		bool hitAfter = MeshCache::load(cachePath, sourceHash, MODEL_IMPORT_FLAGS, cached, cachedNodes);
+		std::remove(standIn.c_str());
+		MeshCache::save(cachePath, sourceHash, MODEL_IMPORT_FLAGS, imported, importedNodes, dependencies);
+
+		if (!hitBefore || hitAfter) {
+			std::cout << "  " << path << ": edited dependency " << (hitAfter ? "still hit the cache" : "missed before the edit") << std::endl;
+			matching = false;
+		}
+	}
+
+	return matching;
+}
+
+// ---------------------------------------------------------------------------------------------- Index Optimizer
+// vertex with an id that follows it through the reordering
+struct TaggedVertex {
+	float position[3];
+	unsigned int id;
+};
+
+static std::vector<std::array<unsigned int, 3>> sortedTriangles(const std::vector<TaggedVertex>& vertices, const std::vector<unsigned int>& indices)
+{
+	std::vector<std::array<unsigned int, 3>> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		triangles.push_back({ vertices[indices[i]].id, vertices[indices[i + 1]].id, vertices[indices[i + 2]].id });
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static void printCacheStats(const char* label, const VertexCacheStats& stats)
+{
+	std::cout << "  " << label << ": ACMR " << stats.acmr << ", ATVR " << stats.atvr << ", " << stats.transformed << " vertices transformed" << std::endl;
+}
+
+bool runIndexOptimizerBenchmark()
+{
+	const unsigned int GRID = 256;
+
+	// a bumpy grid with its triangles and vertices shuffled, the worst order an exporter could write
+	std::vector<TaggedVertex> vertices;
+	for (unsigned int y = 0; y <= GRID; y++) {
+		for (unsigned int x = 0; x <= GRID; x++)
+			vertices.push_back({ { (float)x, std::sin(x * 0.1f) * std::cos(y * 0.1f) * 4.0f, (float)y }, (unsigned int)vertices.size() });
+	}
+
+	std::vector<std::array<unsigned int, 3>> quads;
+	for (unsigned int y = 0; y < GRID; y++) {
+		for (unsigned int x = 0; x < GRID; x++) {
+			unsigned int corner = y * (GRID + 1) + x;
+			quads.push_back({ corner, corner + GRID + 1, corner + 1 });
+			quads.push_back({ corner + 1, corner + GRID + 1, corner + GRID + 2 });
+		}
+	}
+
+	std::mt19937 random(7);
+	std::shuffle(quads.begin(), quads.end(), random);
+	std::shuffle(vertices.begin(), vertices.end(), random);
+
+	std::vector<unsigned int> where(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		where[vertices[i].id] = (unsigned int)i;
+
+	std::vector<unsigned int> indices;
+	for (const std::array<unsigned int, 3>& triangle : quads) {
+		for (unsigned int corner : triangle)
+			indices.push_back(where[corner]);
+	}
+
+	std::vector<std::array<unsigned int, 3>> expected = sortedTriangles(vertices, indices);
+	const size_t vertexCount = vertices.size();
+
+	std::cout << "BENCHMARK: index optimizer, " << indices.size() / 3 << " triangles, " << vertexCount << " vertices" << std::endl;
+
+	VertexCacheStats original = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	printCacheStats("shuffled", original);
+
+	double cacheTime = measureMilliseconds(1, [&] { optimizeVertexCache(indices.data(), indices.size(), vertexCount); });
+	VertexCacheStats cached = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	printCacheStats("vertex cache", cached);
+
+	double overdrawTime = measureMilliseconds(1, [&] {
+		optimizeOverdraw(indices.data(), indices.size(), vertices[0].position, vertexCount, sizeof(TaggedVertex));
+	});
+	VertexCacheStats overdraw = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	printCacheStats("overdraw clusters", overdraw);
+
+	size_t used = 0;
+	double fetchTime = measureMilliseconds(1, [&] {
+		used = optimizeVertexFetch(vertices.data(), vertexCount, sizeof(TaggedVertex), indices.data(), indices.size());
+	});
+	vertices.resize(used);
+	VertexCacheStats fetched = analyzeVertexCache(indices.data(), indices.size(), used);
+	printCacheStats("vertex fetch", fetched);
+
+	std::cout << "  time: vertex cache " << cacheTime << " ms, overdraw " << overdrawTime << " ms, vertex fetch " << fetchTime << " ms" << std::endl;
+
+	bool intact = used == vertexCount && sortedTriangles(vertices, indices) == expected;
+	bool improved = fetched.acmr < original.acmr && fetched.acmr <= overdraw.acmr;
+	if (!intact)
+		std::cout << "  TRIANGLES CHANGED" << std::endl;
+	if (!improved)
+		std::cout << "  CACHE EFFICIENCY DID NOT IMPROVE" << std::endl;
+
+	return intact && improved;
+}
+
+// ---------------------------------------------------------------------------------------------- Vertex Quantization
+struct QuantizationError {
+	float position;	// largest error on any axis, in quantization steps of that axis
+	float normal;	// largest angle, degrees
+	float texCoords;	// largest error, relative to the coordinate
+	bool withinBounds;
+};
+
+static QuantizationError measureQuantization(const std::vector<Vertex>& vertices)
+{
+	AABB bounds;
+	for (const Vertex& vertex : vertices)
+		bounds.expand(vertex.Position);
+
+	std::vector<PackedVertex> packed(vertices.size());
+	packVertices(vertices.data(), vertices.size(), bounds, packed.data());
+	glm::mat4 dequantization = dequantizationMatrix(bounds);
+
+	glm::vec3 step = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f)) / 65535.0f;
+	// float rounding of the box itself, on top of the half step
+	glm::vec3 slack = glm::max(glm::abs(bounds.min), glm::abs(bounds.max)) * 1e-6f;
+
+	QuantizationError error = { 0.0f, 0.0f, 0.0f, true };
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const Vertex& original = vertices[i];
+		Vertex unpacked = unpackVertex(packed[i], dequantization);
+
+		glm::vec3 positionError = glm::abs(unpacked.Position - original.Position);
+		glm::vec3 steps = positionError / step;
+		error.position = std::max(error.position, std::max(steps.x, std::max(steps.y, steps.z)));
+		if (glm::any(glm::greaterThan(positionError, step * 0.5f + slack)))
+			error.withinBounds = false;
+
+		// imports without normals have zero vectors, there is no direction to keep
+		if (glm::length(original.Normal) > 0.5f) {
+			float cosine = glm::dot(glm::normalize(original.Normal), glm::normalize(unpacked.Normal));
+			float degrees = glm::degrees(std::acos(glm::clamp(cosine, -1.0f, 1.0f)));
+			error.normal = std::max(error.normal, degrees);
+			if (degrees > 0.5f)
+				error.withinBounds = false;
+		}
+
+		for (int axis = 0; axis < 2; axis++) {
+			float value = std::abs(original.TexCoords[axis]);
+			float difference = std::abs(unpacked.TexCoords[axis] - original.TexCoords[axis]);
+			// half floats keep 11 significant bits, the smallest step below 2^-14 is 2^-24
+			if (difference > value / 2048.0f + 6e-8f)
+				error.withinBounds = false;
+			if (value > 0.0f)
+				error.texCoords = std::max(error.texCoords, difference / value);
+		}
+	}
+
+	return error;
+}
+
+bool runQuantizationBenchmark()
+{
+	const char* MODELS[] = { "resources/models/backpack/backpack.obj", "resources/models/drone_obj/drone.obj" };
+
+	std::vector<std::pair<std::string, std::vector<Vertex>>> sets;
+
+	// a sphere with tiled texture coordinates, normals in every direction
+	{
+		const int RINGS = 256;
+		std::vector<Vertex> sphere;
+		for (int ring = 0; ring <= RINGS; ring++) {
+			for (int segment = 0; segment <= RINGS * 2; segment++) {
+				float theta = glm::pi<float>() * ring / RINGS;
+				float phi = glm::pi<float>() * segment / RINGS;
+				glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+
+				Vertex vertex;
+				vertex.Normal = normal;
+				vertex.Position = glm::vec3(12.0f, -3.0f, 40.0f) + normal * 25.0f;
+				vertex.TexCoords = glm::vec2(segment / 30.0f, ring / 70.0f);
+				sphere.push_back(vertex);
+			}
+		}
+		sets.push_back({ "sphere", sphere });
+	}
+
+	for (const char* path : MODELS) {
+		std::vector<MeshData> meshes;
+		if (!Model::importMeshes(path, meshes))
+			continue;
+
+		std::vector<Vertex> vertices;
+		for (const MeshData& data : meshes)
+			vertices.insert(vertices.end(), data.vertices.begin(), data.vertices.end());
+		sets.push_back({ path, vertices });
+	}
+
+	std::cout << "BENCHMARK: vertex quantization, " << sizeof(Vertex) << " -> " << sizeof(PackedVertex) << " bytes per vertex" << std::endl;
+
+	bool withinBounds = true;
+	for (const auto& set : sets) {
+		QuantizationError error = measureQuantization(set.second);
+		withinBounds = withinBounds && error.withinBounds;
+
+		std::cout << "  " << set.first << ": " << set.second.size() << " vertices, " << set.second.size() * sizeof(Vertex) / 1024.0 << " KB -> "
+			<< set.second.size() * sizeof(PackedVertex) / 1024.0 << " KB, max error position " << error.position << " steps, normal "
+			<< error.normal << " degrees, texture coords " << error.texCoords << " relative" << (error.withinBounds ? "" : " - OUT OF BOUNDS") << std::endl;
+	}
+
+	return withinBounds;
+}
+
+// ---------------------------------------------------------------------------------------------- Transforms
+const int TRANSFORM_NODES = 100000;
+const int TRANSFORM_GROUP = 64;
+const int TRANSFORM_FRAMES = 100;
+
+bool runTransformBenchmark()
+{
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+	auto randomLocal = [&] {
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(offset(random), offset(random), offset(random)));
+		return glm::rotate(local, angle(random), glm::normalize(glm::vec3(offset(random), 1.0f, offset(random))));
+	};
+
+	// a forest of objects of 64 nodes each, every node under a random earlier node of its object
+	TransformHierarchy hierarchy;
+	hierarchy.reserve(TRANSFORM_NODES);
+	for (int i = 0; i < TRANSFORM_NODES; i++) {
+		int groupStart = i - i % TRANSFORM_GROUP;
+		int parent = i == groupStart ? TransformHierarchy::ROOT : groupStart + (int)(random() % (i - groupStart));
+		hierarchy.add(parent, randomLocal());
+	}
+	hierarchy.update();
+
+	// what updating without dirty flags costs: every world matrix, every frame
+	std::vector<glm::mat4> reference(TRANSFORM_NODES);
+	auto updateAll = [&] {
+		for (int i = 0; i < TRANSFORM_NODES; i++) {
+			int parent = hierarchy.getParent(i);
+			reference[i] = parent != TransformHierarchy::ROOT ? reference[parent] * hierarchy.getLocal(i) : hierarchy.getLocal(i);
+		}
+	};
+
+	const int dirtyPerFrame = TRANSFORM_NODES / 100;
+	std::vector<std::vector<int>> moved(TRANSFORM_FRAMES);
+	std::vector<std::vector<glm::mat4>> movedLocals(TRANSFORM_FRAMES);
+	for (int frame = 0; frame < TRANSFORM_FRAMES; frame++) {
+		for (int i = 0; i < dirtyPerFrame; i++) {
+			moved[frame].push_back((int)(random() % TRANSFORM_NODES));
+			movedLocals[frame].push_back(randomLocal());
+		}
+	}
+
+	using clock = std::chrono::steady_clock;
+	double dirtyMilliseconds = 0.0;
+	double fullMilliseconds = 0.0;
+	size_t recomputed = 0;
+	size_t mismatches = 0;
+	for (int frame = 0; frame < TRANSFORM_FRAMES; frame++) {
+		clock::time_point start = clock::now();
+		for (int i = 0; i < dirtyPerFrame; i++)
+			hierarchy.setLocal(moved[frame][i], movedLocals[frame][i]);
+		recomputed += hierarchy.update();
+		clock::time_point updated = clock::now();
+		updateAll();
+		clock::time_point end = clock::now();
+
+		dirtyMilliseconds += std::chrono::duration<double, std::milli>(updated - start).count();
+		fullMilliseconds += std::chrono::duration<double, std::milli>(end - updated).count();
+
+		// the same products in the same order, so the results are identical
+		for (int i = 0; i < TRANSFORM_NODES; i++) {
+			if (hierarchy.getWorld(i) != reference[i])
+				mismatches++;
+		}
+	}
+
+	std::cout << "BENCHMARK: transform hierarchy, " << TRANSFORM_NODES << " nodes, " << dirtyPerFrame << " moved per frame" << std::endl;
+	std::cout << "  dirty flags: " << dirtyMilliseconds / TRANSFORM_FRAMES << " ms/frame, "
+		<< recomputed / TRANSFORM_FRAMES << " world matrices recomputed" << std::endl;
+	std::cout << "  every node:  " << fullMilliseconds / TRANSFORM_FRAMES << " ms/frame, " << TRANSFORM_NODES << " world matrices" << std::endl;
+	std::cout << "  " << mismatches << " world matrices differ" << std::endl;
+
+	return mismatches == 0;
+}
+
+// ---------------------------------------------------------------------------------------------- Scene Nodes
+bool runSceneNodeBenchmark(Model& model, Shader& shader)
+{
+	const int FRAMES = 100;
+
+	// the camera looks at a spot beside the model, far enough that the box at rest is never in view
+	const AABB& rest = model.getBounds();
+	glm::vec3 size = rest.max - rest.min;
+	glm::vec3 offset(2.0f * std::max(size.x, std::max(size.y, size.z)) + 10.0f, 0.0f, 0.0f);
+	glm::vec3 target = 0.5f * (rest.min + rest.max) + offset;
+	float distance = 2.0f * glm::length(size) + 1.0f;
+	glm::mat4 view = glm::lookAt(target + glm::vec3(0.0f, 0.0f, distance), target, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(30.0f), 1.0f, 0.1f, 2.0f * distance);
+
+	Scene scene;
+	scene.add(model, shader, glm::mat4(1.0f));
+	RenderQueue queue;
+
+	// the root moves every mesh of the model, the scene has to follow it without a rebuild
+	const int node = 0;
+	glm::mat4 local = model.getNodes().getLocal(node);
+	glm::mat4 moved = glm::translate(glm::mat4(1.0f), offset) * local;
+
+	auto visibleAfter = [&](const glm::mat4& transform) {
+		model.setNodeTransform(node, transform);
+		queue.begin(view, projection, 0.1f, 2.0f * distance);
+		scene.submit(queue);
+		return scene.visibleCount();
+	};
+
+	size_t atRest = visibleAfter(local);
+	size_t whenMoved = visibleAfter(moved);
+	size_t movedBack = visibleAfter(local);
+
+	// a node moving every frame, every submit refits the tree
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t visibleFrames = 0;
+	for (int frame = 0; frame < FRAMES; frame++)
+		visibleFrames += visibleAfter(frame % 2 ? moved : local);
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	model.setNodeTransform(node, local);
+	model.updateNodes();
+
+	std::cout << "BENCHMARK: scene nodes, " << model.meshCount() << " meshes under the moved node" << std::endl;
+	std::cout << "  visible at rest " << atRest << ", moved into view " << whenMoved << ", moved back " << movedBack << std::endl;
+	std::cout << "  moving every frame: " << milliseconds / FRAMES << " ms/frame, visible in " << visibleFrames << " of " << FRAMES << " frames" << std::endl;
+
+	return atRest == 0 && whenMoved == 1 && movedBack == 0 && visibleFrames == FRAMES / 2;
+}
+
+// ---------------------------------------------------------------------------------------------- Async Loading
+bool runLoadingBenchmark(GLFWwindow* window, double stallBudgetMilliseconds)
+{
+	using clock = std::chrono::steady_clock;
+
+	const char* MODELS[] = { "resources/models/backpack/backpack.obj", "resources/models/drone_obj/drone.obj" };
+	const int LOADS = 16;
+	const int PRIORITIES = 4;
+	// every fifth load is cancelled, each on a different frame so they stop at different stages
+	const int CANCEL_EVERY = 5;
+	const double PUMP_BUDGET = 4.0;
+
+	std::cout << "BENCHMARK: async loading, " << LOADS << " loads, " << PUMP_BUDGET << " ms upload budget, "
+		<< stallBudgetMilliseconds << " ms stall budget" << std::endl;
+
+	// unthrottled, so a frame's time is the loader's cost and not the display's
+	glfwSwapInterval(0);
+
+	ModelLoader loader;
+	std::vector<std::shared_ptr<Model>> models;
+	for (int i = 0; i < LOADS; i++)
+		models.push_back(loader.load(MODELS[i % 2], i % PRIORITIES));
+
+	clock::time_point start = clock::now();
+	clock::time_point last = start;
+	double worstFrame = 0.0;
+	double worstPump = 0.0;
+	int frames = 0;
+	while (!loader.idle()) {
+		for (int i = CANCEL_EVERY - 1; i < LOADS; i += CANCEL_EVERY) {
+			if (frames == i)
+				loader.cancel(*models[i]);
+		}
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		clock::time_point pumpStart = clock::now();
+		loader.pump(PUMP_BUDGET);
+		worstPump = std::max(worstPump, std::chrono::duration<double, std::milli>(clock::now() - pumpStart).count());
+
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+
+		clock::time_point now = clock::now();
+		worstFrame = std::max(worstFrame, std::chrono::duration<double, std::milli>(now - last).count());
+		last = now;
+		frames++;
+	}
+	double total = std::chrono::duration<double, std::milli>(last - start).count();
+
+	bool correct = true;
+	for (int i = 0; i < LOADS; i++) {
+		ModelState state = models[i]->getState();
+		// a cancel that came after the load finished leaves the model ready
+		bool expected = (i % CANCEL_EVERY == CANCEL_EVERY - 1) ? (state == MODEL_CANCELLED || state == MODEL_READY)
+			: (state == MODEL_READY && models[i]->meshCount() > 0);
+		if (!expected) {
+			std::cout << "  WRONG STATE: load " << i << " (" << MODELS[i % 2] << ") ended in state " << state << std::endl;
+			correct = false;
+		}
+	}
+
+	// the same path twice before either is read: one read serves both, and a cancel of the first
+	// leaves the second to finish with meshes of its own
+	ModelLoader duplicates;
+	std::shared_ptr<Model> first = duplicates.load(MODELS[1]);
+	std::shared_ptr<Model> second = duplicates.load(MODELS[1]);
+	std::shared_ptr<Model> third = duplicates.load(MODELS[1]);
+	duplicates.cancel(*first);
+	duplicates.finish();
+	bool shared = duplicates.readCount() == 1 && first->getState() == MODEL_CANCELLED && second->getState() == MODEL_READY
+		&& third->getState() == MODEL_READY && second->meshCount() > 0 && second->meshCount() == third->meshCount();
+	if (!shared) {
+		std::cout << "  WRONG SHARED READ: " << duplicates.readCount() << " reads, states " << first->getState() << " "
+			<< second->getState() << " " << third->getState() << ", " << second->meshCount() << " and " << third->meshCount() << " meshes" << std::endl;
+		correct = false;
+	}
+
+	// the same file through the blocking constructor, all of it in one frame
+	double blocking = measureMilliseconds(1, [&] { Model model(MODELS[0]); });
+
+	bool withinBudget = worstFrame <= stallBudgetMilliseconds;
+	std::cout << "  async: " << frames << " frames in " << total << " ms, " << total / frames << " ms average, worst frame "
+		<< worstFrame << " ms, worst pump " << worstPump << " ms" << (withinBudget ? "" : " - OVER BUDGET") << std::endl;
+	std::cout << "  " << loader.readCount() << " reads for " << LOADS << " loads" << std::endl;
+	std::cout << "  blocking constructor: " << blocking << " ms in a single frame" << std::endl;
+
+	return correct && withinBudget;
+}
@@ -0,0 +1,66 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "model.h"
+#include "shader.h"
+#include "uniformbuffer.h"
+
+// Benchmark scenes selected from the command line in main(). Each one runs its renderer paths
+// back to back on the same scene, prints the comparison and returns.
+
+// Flat SIMD frustum culling against the BVH over 1k, 10k and 100k scattered boxes. CPU only.
+void runCullingBenchmark();
+
+// Occlusion culler against scenes with known answers, then raster and query timings. CPU only.
+// Returns false when any known answer is wrong.
+bool runOcclusionBenchmark();
+
+// Loads the project's models through Assimp and through the mesh cache, checks both give the same
+// meshes and node trees and compares the times, then edits a dependency of the cache. CPU only.
+// Returns false when the results differ or the edited dependency still hits the cache.
+bool runMeshCacheBenchmark();
+
+// Index optimization on a shuffled grid: cache statistics before and after each stage, checking
+// every triangle survives. CPU only. Returns false when triangles are lost or the cache got worse.
+bool runIndexOptimizerBenchmark();
+
+// Packs a sphere and the project's models into PackedVertex and compares them with the float
+// vertices. CPU only. Returns false when any attribute is off by more than its format allows.
+bool runQuantizationBenchmark();
+
+// 100k nodes in 64-node objects with 1% of them moved every frame, updated through the dirty flags
+// and recomputed whole. CPU only. Returns false when the two disagree on any world matrix.
+bool runTransformBenchmark();
+
+// Places the model in a scene and moves its root node into and out of a view that misses the model
+// at rest, submitting after each move. Returns false when the scene culls it by its old box.
+bool runSceneNodeBenchmark(Model& model, Shader& shader);
+
+// Loads the project's models many times at once through ModelLoader with mixed priorities and some
+// cancels, while running empty frames, then one path three times with the first load cancelled.
+// Returns false when any frame took longer than the stall budget, a load ended in the wrong state or
+// the three loads of one path did not share a single read.
+bool runLoadingBenchmark(GLFWwindow* window, double stallBudgetMilliseconds);
+
+// 10k copies of one model, drawn through the render queue and then with DrawInstanced.
+void runInstancingBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& shader, Shader& instancedShader);
+
+// The same 10k copies drawn mesh by mesh, as on a GL 3.3 context, then in multi-draw batches when
+// multiDrawShader is given and the context supports them. Returns false when the two images differ.
+bool runMultiDrawBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& shader, Shader* multiDrawShader);
+
+// Per-draw matrices for 10k draws, computed one by one with glm and in one batch, then 1k copies of
+// the model with the vertex shader deriving them per vertex and reading them per draw, rasterizer
+// discarded. Returns false when the batch disagrees with glm.
+bool runVertexTransformBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& shader);
+
+// GPU frustum and Hi-Z culling of 128k instances, checked against the CPU frustum and occlusion
+// culling of the same boxes, then whole frames culled on each side. Needs GLEXT_ARB_compute_shader.
+// Returns false when the GPU frustum test disagrees with the CPU's away from the planes, or the GPU
+// hides any instance that the CPU occlusion test keeps.
+bool runGpuCullingBenchmark(GLFWwindow* window, UniformBuffer& frameUBO, Model& model, Shader& instancedShader);
+
+#endif //BENCHMARKS_H
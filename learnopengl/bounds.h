@@ -0,0 +1,118 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+// ---------------------------------------------------------------------------------------------- Bounding Volumes
+struct AABB {
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	AABB() {}
+	AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+	bool isEmpty() const { return min.x > max.x; }
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+	float surfaceArea() const
+	{
+		glm::vec3 size = max - min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	void expand(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void expand(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	// Box around this box after an affine transform, without transforming all eight corners.
+	AABB transformed(const glm::mat4& matrix) const
+	{
+		if (isEmpty())
+			return AABB();
+
+		glm::vec3 center = glm::vec3(matrix * glm::vec4(this->center(), 1.0f));
+		glm::vec3 extents = this->extents();
+		glm::vec3 worldExtents = glm::abs(glm::vec3(matrix[0])) * extents.x
+			+ glm::abs(glm::vec3(matrix[1])) * extents.y
+			+ glm::abs(glm::vec3(matrix[2])) * extents.z;
+
+		return AABB(center - worldExtents, center + worldExtents);
+	}
+};
+
+struct BoundingSphere {
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+// ---------------------------------------------------------------------------------------------- Frustum
+enum FrustumPlane {
+	PLANE_LEFT,
+	PLANE_RIGHT,
+	PLANE_BOTTOM,
+	PLANE_TOP,
+	PLANE_NEAR,
+	PLANE_FAR,
+	PLANE_COUNT
+};
+
+// Planes as (normal, distance) with the normals pointing into the frustum.
+struct Frustum {
+	glm::vec4 planes[PLANE_COUNT];
+
+	// Gribb/Hartmann extraction from projection * view, for OpenGL's -w..w clip volume.
+	static Frustum fromMatrix(const glm::mat4& viewProjection)
+	{
+		glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		Frustum frustum;
+		frustum.planes[PLANE_LEFT]		= row3 + row0;
+		frustum.planes[PLANE_RIGHT]		= row3 - row0;
+		frustum.planes[PLANE_BOTTOM]	= row3 + row1;
+		frustum.planes[PLANE_TOP]		= row3 - row1;
+		frustum.planes[PLANE_NEAR]		= row3 + row2;
+		frustum.planes[PLANE_FAR]		= row3 - row2;
+
+		for (glm::vec4& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		return frustum;
+	}
+
+	bool intersects(const AABB& box) const
+	{
+		glm::vec3 center = box.center();
+		glm::vec3 extents = box.extents();
+		for (const glm::vec4& plane : planes) {
+			glm::vec3 normal = glm::vec3(plane);
+			if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extents) < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	bool intersects(const BoundingSphere& sphere) const
+	{
+		for (const glm::vec4& plane : planes) {
+			if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+				return false;
+		}
+		return true;
+	}
+};
+
+#endif //BOUNDS_H
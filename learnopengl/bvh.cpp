@@ -0,0 +1,258 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+// ---------------------------------------------------------------------------------------------- Build
+void BVH::build(const std::vector<AABB>& boxes)
+{
+	this->boxes = boxes;
+	nodes.clear();
+	objects.resize(boxes.size());
+	leafOf.assign(boxes.size(), -1);
+	dirty.clear();
+	hasDirty = false;
+
+	if (boxes.empty())
+		return;
+
+	std::vector<glm::vec3> centroids(boxes.size());
+	AABB root;
+	for (size_t i = 0; i < boxes.size(); i++) {
+		objects[i] = (int)i;
+		centroids[i] = boxes[i].center();
+		root.expand(boxes[i]);
+	}
+
+	nodes.reserve(boxes.size() * 2);
+	nodes.push_back({ root, 0, (int)boxes.size(), -1 });
+	subdivide(0, centroids);
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+		for (int j = 0; j < nodes[i].count; j++)
+			leafOf[objects[nodes[i].first + j]] = (int)i;
+	}
+	dirty.assign(nodes.size(), 0);
+}
+
+void BVH::subdivide(int node, std::vector<glm::vec3>& centroids)
+{
+	int first = nodes[node].first;
+	int count = nodes[node].count;
+	if (count <= MAX_LEAF_OBJECTS)
+		return;
+
+	int axis;
+	float position;
+	if (!findSplit(nodes[node], centroids, axis, position))
+		return;
+
+	int* begin = objects.data() + first;
+	int* middle = std::partition(begin, begin + count, [&](int object) { return centroids[object][axis] < position; });
+	int leftCount = (int)(middle - begin);
+	if (leftCount == 0 || leftCount == count)
+		return;
+
+	AABB leftBounds, rightBounds;
+	for (int i = first; i < first + leftCount; i++)
+		leftBounds.expand(boxes[objects[i]]);
+	for (int i = first + leftCount; i < first + count; i++)
+		rightBounds.expand(boxes[objects[i]]);
+
+	int left = (int)nodes.size();
+	nodes.push_back({ leftBounds, first, leftCount, node });
+	nodes.push_back({ rightBounds, first + leftCount, count - leftCount, node });
+	nodes[node].first = left;
+	nodes[node].count = 0;
+
+	subdivide(left, centroids);
+	subdivide(left + 1, centroids);
+}
+
+// Bins the centroids along each axis and picks the bin boundary with the lowest
+// area * count cost. Returns false when no split is cheaper than keeping the node as a leaf.
+bool BVH::findSplit(const Node& node, const std::vector<glm::vec3>& centroids, int& axis, float& position) const
+{
+	AABB centroidBounds;
+	for (int i = node.first; i < node.first + node.count; i++)
+		centroidBounds.expand(centroids[objects[i]]);
+
+	float bestCost = node.count * node.bounds.surfaceArea();
+	bool found = false;
+
+	for (int a = 0; a < 3; a++) {
+		float minimum = centroidBounds.min[a];
+		float extent = centroidBounds.max[a] - minimum;
+		if (extent <= 0.0f)
+			continue;
+
+		AABB binBounds[SAH_BINS];
+		int binCounts[SAH_BINS] = {};
+		float scale = SAH_BINS / extent;
+		for (int i = node.first; i < node.first + node.count; i++) {
+			int object = objects[i];
+			int bin = std::min(SAH_BINS - 1, (int)((centroids[object][a] - minimum) * scale));
+			binCounts[bin]++;
+			binBounds[bin].expand(boxes[object]);
+		}
+
+		// sweep from the right to get the cost of every right side, then from the left
+		float rightAreas[SAH_BINS - 1];
+		int rightCounts[SAH_BINS - 1];
+		AABB right;
+		int rightCount = 0;
+		for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+			right.expand(binBounds[bin]);
+			rightCount += binCounts[bin];
+			rightAreas[bin - 1] = right.isEmpty() ? 0.0f : right.surfaceArea();
+			rightCounts[bin - 1] = rightCount;
+		}
+
+		AABB left;
+		int leftCount = 0;
+		for (int bin = 0; bin < SAH_BINS - 1; bin++) {
+			left.expand(binBounds[bin]);
+			leftCount += binCounts[bin];
+			if (leftCount == 0 || rightCounts[bin] == 0)
+				continue;
+
+			float cost = leftCount * left.surfaceArea() + rightCounts[bin] * rightAreas[bin];
+			if (cost < bestCost) {
+				bestCost = cost;
+				axis = a;
+				position = minimum + (bin + 1) / scale;
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+// ---------------------------------------------------------------------------------------------- Refit
+void BVH::update(int object, const AABB& box)
+{
+	boxes[object] = box;
+	dirty[leafOf[object]] = 1;
+	hasDirty = true;
+}
+
+void BVH::refit()
+{
+	if (!hasDirty)
+		return;
+
+	// children are always stored after their parent, so a reverse walk visits them first
+	for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+		if (!dirty[i])
+			continue;
+
+		Node& node = nodes[i];
+		AABB bounds;
+		if (node.count > 0) {
+			for (int j = node.first; j < node.first + node.count; j++)
+				bounds.expand(boxes[objects[j]]);
+		}
+		else {
+			bounds.expand(nodes[node.first].bounds);
+			bounds.expand(nodes[node.first + 1].bounds);
+		}
+		node.bounds = bounds;
+
+		dirty[i] = 0;
+		if (node.parent >= 0)
+			dirty[node.parent] = 1;
+	}
+
+	hasDirty = false;
+}
+
+// ---------------------------------------------------------------------------------------------- Traversal
+enum PlaneResult {
+	OUTSIDE_PLANE,
+	CROSSES_PLANE,
+	INSIDE_PLANE
+};
+
+static PlaneResult testPlane(const glm::vec4& plane, const AABB& box)
+{
+	glm::vec3 normal = glm::vec3(plane);
+	float distance = glm::dot(normal, box.center()) + plane.w;
+	float radius = glm::dot(glm::abs(normal), box.extents());
+
+	if (distance + radius < 0.0f)
+		return OUTSIDE_PLANE;
+	if (distance - radius >= 0.0f)
+		return INSIDE_PLANE;
+	return CROSSES_PLANE;
+}
+
+// Tests the box against the planes still set in mask, clearing the ones it is fully inside of.
+static bool testPlanes(const Frustum& frustum, const AABB& box, uint8_t& mask)
+{
+	for (int plane = 0; plane < PLANE_COUNT; plane++) {
+		if (!(mask & (1 << plane)))
+			continue;
+
+		PlaneResult result = testPlane(frustum.planes[plane], box);
+		if (result == OUTSIDE_PLANE)
+			return false;
+		if (result == INSIDE_PLANE)
+			mask &= ~(1 << plane);
+	}
+	return true;
+}
+
+void BVH::cull(const Frustum& frustum, std::vector<int>& visible) const
+{
+	if (nodes.empty())
+		return;
+
+	struct Entry {
+		int node;
+		uint8_t planes;
+	};
+
+	Entry stack[64];
+	int top = 0;
+	stack[top++] = { 0, (1 << PLANE_COUNT) - 1 };
+
+	while (top > 0) {
+		Entry entry = stack[--top];
+		const Node& node = nodes[entry.node];
+
+		uint8_t planes = entry.planes;
+		if (!testPlanes(frustum, node.bounds, planes))
+			continue;
+
+		if (planes == 0) {
+			appendSubtree(entry.node, visible);
+		}
+		else if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				uint8_t objectPlanes = planes;
+				if (testPlanes(frustum, boxes[objects[i]], objectPlanes))
+					visible.push_back(objects[i]);
+			}
+		}
+		else if (top + 2 <= 64) {
+			stack[top++] = { node.first + 1, planes };
+			stack[top++] = { node.first, planes };
+		}
+		else {
+			// deeper than the stack, only reachable with degenerate input: keep everything below
+			appendSubtree(entry.node, visible);
+		}
+	}
+}
+
+void BVH::appendSubtree(int node, std::vector<int>& visible) const
+{
+	const Node& current = nodes[node];
+	if (current.count > 0) {
+		visible.insert(visible.end(), objects.begin() + current.first, objects.begin() + current.first + current.count);
+		return;
+	}
+
+	appendSubtree(current.first, visible);
+	appendSubtree(current.first + 1, visible);
+}
@@ -0,0 +1,54 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "bounds.h"
+
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over a set of boxes, identified by their index in the array passed to
+// build(). Moving objects are handled by refitting the existing tree; rebuild when the layout has
+// changed so much that the refitted boxes overlap badly.
+class BVH {
+public:
+	// Builds the tree from scratch, splitting with the binned surface area heuristic.
+	void build(const std::vector<AABB>& boxes);
+
+	// Replaces one object's box. The change reaches the upper levels on the next refit().
+	void update(int object, const AABB& box);
+	// Recomputes the boxes of every node above an updated object, bottom up.
+	void refit();
+
+	// Appends every object whose box touches the frustum. Subtrees entirely inside are appended
+	// without testing their children, subtrees entirely outside are skipped.
+	void cull(const Frustum& frustum, std::vector<int>& visible) const;
+
+	size_t size() const { return boxes.size(); }
+	size_t nodeCount() const { return nodes.size(); }
+
+private:
+	static const int MAX_LEAF_OBJECTS = 4;
+	static const int SAH_BINS = 16;
+
+	// leaves have count > 0 and own objects[first, first + count), inner nodes have their children
+	// at first and first + 1
+	struct Node {
+		AABB bounds;
+		int first;
+		int count;
+		int parent;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<AABB> boxes;
+	std::vector<int> objects;
+	std::vector<int> leafOf;
+	std::vector<uint8_t> dirty;
+	bool hasDirty = false;
+
+	void subdivide(int node, std::vector<glm::vec3>& centroids);
+	bool findSplit(const Node& node, const std::vector<glm::vec3>& centroids, int& axis, float& position) const;
+	void appendSubtree(int node, std::vector<int>& visible) const;
+};
+
+#endif //BVH_H
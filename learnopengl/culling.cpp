@@ -0,0 +1,123 @@
+#include "culling.h"
+
+// the AVX2 path uses fused multiply-adds, which GCC and Clang only enable with FMA on top of AVX2.
+// MSVC's /arch:AVX2 implies FMA without defining __FMA__.
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define CULLING_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE
+#endif
+
+#include <cmath>
+
+void FrustumCuller::clear()
+{
+	count = 0;
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void FrustumCuller::add(const AABB& box)
+{
+	if (count % LANES == 0) {
+		// padding boxes sit at the origin with no size, their results are never read
+		size_t padded = count + LANES;
+		centerX.resize(padded, 0.0f);
+		centerY.resize(padded, 0.0f);
+		centerZ.resize(padded, 0.0f);
+		extentX.resize(padded, 0.0f);
+		extentY.resize(padded, 0.0f);
+		extentZ.resize(padded, 0.0f);
+	}
+
+	glm::vec3 center = box.center();
+	glm::vec3 extents = box.extents();
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	extentX[count] = extents.x;
+	extentY[count] = extents.y;
+	extentZ[count] = extents.z;
+	count++;
+}
+
+// A box is outside when it lies entirely behind one plane: dot(n, c) + d + dot(|n|, e) < 0.
+size_t FrustumCuller::cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+	visible.resize(centerX.size());
+	size_t visibleCount = 0;
+
+#if defined(CULLING_AVX2)
+	for (size_t i = 0; i < count; i += 8) {
+		__m256 cx = _mm256_loadu_ps(&centerX[i]);
+		__m256 cy = _mm256_loadu_ps(&centerY[i]);
+		__m256 cz = _mm256_loadu_ps(&centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&extentX[i]);
+		__m256 ey = _mm256_loadu_ps(&extentY[i]);
+		__m256 ez = _mm256_loadu_ps(&extentZ[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes) {
+			__m256 distance = _mm256_fmadd_ps(cx, _mm256_set1_ps(plane.x),
+				_mm256_fmadd_ps(cy, _mm256_set1_ps(plane.y),
+				_mm256_fmadd_ps(cz, _mm256_set1_ps(plane.z), _mm256_set1_ps(plane.w))));
+			__m256 radius = _mm256_fmadd_ps(ex, _mm256_set1_ps(std::fabs(plane.x)),
+				_mm256_fmadd_ps(ey, _mm256_set1_ps(std::fabs(plane.y)),
+				_mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(plane.z)))));
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++)
+			visible[i + lane] = (mask >> lane) & 1;
+	}
+#elif defined(CULLING_SSE)
+	for (size_t i = 0; i < count; i += 4) {
+		__m128 cx = _mm_loadu_ps(&centerX[i]);
+		__m128 cy = _mm_loadu_ps(&centerY[i]);
+		__m128 cz = _mm_loadu_ps(&centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]);
+		__m128 ey = _mm_loadu_ps(&extentY[i]);
+		__m128 ez = _mm_loadu_ps(&extentZ[i]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes) {
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y)))),
+				_mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++)
+			visible[i + lane] = (mask >> lane) & 1;
+	}
+#else
+	for (size_t i = 0; i < count; i++) {
+		bool inside = true;
+		for (const glm::vec4& plane : frustum.planes) {
+			float distance = centerX[i] * plane.x + centerY[i] * plane.y + centerZ[i] * plane.z + plane.w;
+			float radius = extentX[i] * std::fabs(plane.x) + extentY[i] * std::fabs(plane.y) + extentZ[i] * std::fabs(plane.z);
+			inside = inside && distance + radius >= 0.0f;
+		}
+		visible[i] = inside;
+	}
+#endif
+
+	visible.resize(count);
+	for (size_t i = 0; i < count; i++)
+		visibleCount += visible[i];
+
+	return visibleCount;
+}
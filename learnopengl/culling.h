@@ -0,0 +1,31 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "bounds.h"
+
+#include <cstdint>
+#include <vector>
+
+// Boxes stored as separate centre and extent arrays so the frustum test runs over several boxes per
+// instruction: 8 at a time with AVX2 and FMA, 4 with SSE and one at a time on other targets.
+class FrustumCuller {
+public:
+	void clear();
+	void add(const AABB& box);
+
+	// Writes 1 for every box touching the frustum and 0 for the rest, in the order they were added.
+	// Returns the number of visible boxes.
+	size_t cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+	size_t size() const { return count; }
+
+private:
+	// arrays are kept padded to a multiple of the widest kernel so it never needs a remainder loop
+	static const size_t LANES = 8;
+
+	size_t count = 0;
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+};
+
+#endif //CULLING_H
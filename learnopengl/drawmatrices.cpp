@@ -0,0 +1,97 @@
+#include "drawmatrices.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DRAWMATRICES_SSE
+#endif
+
+// The rows of inverse(m) are the cross products of its columns over the determinant, so they are the
+// columns of the inverse transpose.
+glm::mat3 normalMatrix(const glm::mat4& model)
+{
+	glm::vec3 c0 = glm::vec3(model[0]);
+	glm::vec3 c1 = glm::vec3(model[1]);
+	glm::vec3 c2 = glm::vec3(model[2]);
+
+	glm::vec3 n0 = glm::cross(c1, c2);
+	float inverseDeterminant = 1.0f / glm::dot(c0, n0);
+
+	return glm::mat3(n0 * inverseDeterminant, glm::cross(c2, c0) * inverseDeterminant, glm::cross(c0, c1) * inverseDeterminant);
+}
+
+#if defined(DRAWMATRICES_SSE)
+// (a * b.yzx - a.yzx * b).yzx, the w lane comes out 0
+static inline __m128 cross(__m128 a, __m128 b)
+{
+	__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// sum of all 4 lanes in every lane
+static inline __m128 horizontalSum(__m128 v)
+{
+	__m128 sum = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// column j of a * b is a's columns weighted by column j of b
+static inline void multiply(const __m128 a[4], const __m128 b[4], __m128 out[4])
+{
+	for (int j = 0; j < 4; j++) {
+		__m128 column = _mm_mul_ps(a[0], _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(0, 0, 0, 0)));
+		column = _mm_add_ps(column, _mm_mul_ps(a[1], _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(1, 1, 1, 1))));
+		column = _mm_add_ps(column, _mm_mul_ps(a[2], _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(2, 2, 2, 2))));
+		column = _mm_add_ps(column, _mm_mul_ps(a[3], _mm_shuffle_ps(b[j], b[j], _MM_SHUFFLE(3, 3, 3, 3))));
+		out[j] = column;
+	}
+}
+
+static inline void load(const glm::mat4& m, __m128 out[4])
+{
+	for (int j = 0; j < 4; j++)
+		out[j] = _mm_loadu_ps(&m[j][0]);
+}
+
+static inline void store(const __m128 m[4], glm::mat4& out)
+{
+	for (int j = 0; j < 4; j++)
+		_mm_storeu_ps(&out[j][0], m[j]);
+}
+#endif
+
+void computeDrawMatrices(const glm::mat4& viewProjection, const glm::mat4* models, const glm::mat4* locals, size_t count, DrawMatrices* out)
+{
+#if defined(DRAWMATRICES_SSE)
+	__m128 vp[4];
+	load(viewProjection, vp);
+	const __m128 wColumn = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (size_t i = 0; i < count; i++) {
+		__m128 model[4], local[4], world[4], mvp[4];
+		load(models[i], model);
+		load(locals[i], local);
+		multiply(model, local, world);
+		multiply(vp, world, mvp);
+		store(world, out[i].model);
+		store(mvp, out[i].modelViewProjection);
+
+		// the crosses have w = 0, which also drops whatever the model's w row holds from the dot
+		__m128 n0 = cross(model[1], model[2]);
+		__m128 n1 = cross(model[2], model[0]);
+		__m128 n2 = cross(model[0], model[1]);
+		__m128 determinant = horizontalSum(_mm_mul_ps(model[0], n0));
+		_mm_storeu_ps(&out[i].normalMatrix[0][0], _mm_div_ps(n0, determinant));
+		_mm_storeu_ps(&out[i].normalMatrix[1][0], _mm_div_ps(n1, determinant));
+		_mm_storeu_ps(&out[i].normalMatrix[2][0], _mm_div_ps(n2, determinant));
+		_mm_storeu_ps(&out[i].normalMatrix[3][0], wColumn);
+	}
+#else
+	for (size_t i = 0; i < count; i++) {
+		out[i].model = models[i] * locals[i];
+		out[i].modelViewProjection = viewProjection * out[i].model;
+		out[i].normalMatrix = glm::mat4(normalMatrix(models[i]));
+	}
+#endif
+}
@@ -0,0 +1,25 @@
+#ifndef DRAWMATRICES_H
+#define DRAWMATRICES_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Everything the vertex shaders used to derive per vertex, computed once per draw on the CPU. Also
+// the per-draw entry a MULTI_DRAW shader reads at gl_DrawIDARB: the normal matrix is a mat3 in a
+// mat4, which keeps the std430 layout free of padding at 192 bytes per draw.
+struct DrawMatrices {
+	glm::mat4 model;				// mesh dequantization folded in
+	glm::mat4 normalMatrix;
+	glm::mat4 modelViewProjection;	// dequantization folded in as well
+};
+
+// Inverse transpose of the upper 3x3 of model, from the cross products of its columns.
+glm::mat3 normalMatrix(const glm::mat4& model);
+
+// For every draw: model = models[i] * locals[i], modelViewProjection = viewProjection * model and
+// the normal matrix of models[i] alone, since normals are packed independently of the mesh box.
+// Runs 4 floats per instruction with SSE and one at a time on other targets.
+void computeDrawMatrices(const glm::mat4& viewProjection, const glm::mat4* models, const glm::mat4* locals, size_t count, DrawMatrices* out);
+
+#endif //DRAWMATRICES_H
@@ -0,0 +1,391 @@
+#include "geometrybuffer.h"
+#include "glstate.h"
+#include "mesh.h"
+#include "vertexformat.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// ---------------------------------------------------------------------------------------------- Range Allocator
+RangeAllocator::RangeAllocator(size_t capacity)
+	: total(capacity), freeSize(capacity)
+{
+	if (capacity > 0)
+		freeBlocks[0] = capacity;
+}
+
+size_t RangeAllocator::allocate(size_t size, size_t alignment)
+{
+	return allocateBelow(size, NONE, alignment);
+}
+
+size_t RangeAllocator::allocateBelow(size_t size, size_t limit, size_t alignment)
+{
+	// empty ranges take no space, any offset will do
+	if (size == 0)
+		return 0;
+
+	std::map<size_t, size_t>::iterator best = freeBlocks.end();
+	size_t bestOffset = NONE;
+	size_t bestWaste = NONE;
+	for (std::map<size_t, size_t>::iterator block = freeBlocks.begin(); block != freeBlocks.end() && block->first < limit; ++block) {
+		size_t offset = alignUp(block->first, alignment);
+		size_t padding = offset - block->first;
+		if (padding + size > block->second || offset + size > limit)
+			continue;
+
+		size_t waste = block->second - padding - size;
+		if (waste < bestWaste) {
+			best = block;
+			bestOffset = offset;
+			bestWaste = waste;
+			if (waste == 0)
+				break;
+		}
+	}
+
+	if (best == freeBlocks.end())
+		return NONE;
+
+	size_t blockStart = best->first;
+	size_t blockEnd = best->first + best->second;
+	freeBlocks.erase(best);
+
+	// alignment padding and the rest stay free
+	if (bestOffset > blockStart)
+		freeBlocks[blockStart] = bestOffset - blockStart;
+	if (blockEnd > bestOffset + size)
+		freeBlocks[bestOffset + size] = blockEnd - (bestOffset + size);
+
+	freeSize -= size;
+	return bestOffset;
+}
+
+void RangeAllocator::release(size_t offset, size_t size)
+{
+	if (size == 0)
+		return;
+
+	freeSize += size;
+
+	std::map<size_t, size_t>::iterator next = freeBlocks.lower_bound(offset);
+	if (next != freeBlocks.end() && offset + size == next->first) {
+		size += next->second;
+		next = freeBlocks.erase(next);
+	}
+
+	if (next != freeBlocks.begin()) {
+		std::map<size_t, size_t>::iterator previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			previous->second += size;
+			return;
+		}
+	}
+
+	freeBlocks[offset] = size;
+}
+
+size_t RangeAllocator::largestFreeBlock() const
+{
+	size_t largest = 0;
+	for (const auto& block : freeBlocks)
+		largest = std::max(largest, block.second);
+
+	return largest;
+}
+
+bool RangeAllocator::isCompact() const
+{
+	if (freeBlocks.empty())
+		return true;
+
+	return freeBlocks.size() == 1 && freeBlocks.begin()->first + freeBlocks.begin()->second == total;
+}
+
+// ---------------------------------------------------------------------------------------------- Arenas
+size_t vertexStride(VertexLayout layout)
+{
+	return layout == LAYOUT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+unsigned int GeometryBuffer::createArena(VertexLayout layout, size_t vertexCount, size_t indexBytes)
+{
+	const size_t stride = vertexStride(layout);
+
+	Arena arena;
+	arena.layout = layout;
+	arena.vertices = RangeAllocator(std::max(GEOMETRY_ARENA_VERTEX_BYTES / stride, vertexCount));
+	arena.indices = RangeAllocator(std::max(GEOMETRY_ARENA_INDEX_BYTES, alignUp(indexBytes, 4)));
+	arena.instanceBuffer = 0;
+
+	glGenVertexArrays(1, &arena.vao);
+	glGenBuffers(1, &arena.vertexBuffer);
+	glGenBuffers(1, &arena.indexBuffer);
+
+	glState.bindVertexArray(arena.vao);
+	glState.bindBuffer(GL_ARRAY_BUFFER, arena.vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, arena.vertices.capacity() * stride, NULL, GL_STATIC_DRAW);
+	glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indices.capacity(), NULL, GL_STATIC_DRAW);
+
+	if (layout == LAYOUT_PACKED) {
+		// the shader still reads vec3 position and normal and vec2 texture coords
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+	}
+	else {
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+	}
+
+	glState.bindVertexArray(0);
+
+	std::cout << "GEOMETRY: arena " << arenas.size() << " - " << (layout == LAYOUT_PACKED ? "packed" : "float") << " layout, "
+		<< arena.vertices.capacity() * stride / (1024.0 * 1024.0) << " MB vertices, " << arena.indices.capacity() / (1024.0 * 1024.0) << " MB indices" << std::endl;
+
+	arenas.push_back(arena);
+	return (unsigned int)arenas.size() - 1;
+}
+
+// ---------------------------------------------------------------------------------------------- Allocations
+GeometryHandle GeometryBuffer::allocate(VertexLayout layout, const void* vertices, size_t vertexCount, const void* indices, size_t indexBytes)
+{
+	Allocation allocation = { 0, RangeAllocator::NONE, vertexCount, RangeAllocator::NONE, indexBytes, true };
+	// ranges are whole 4 byte words, an odd count of 16 bit indices would otherwise leave a hole
+	// behind it that no other range can use and the arena would never count as compact
+	size_t indexRange = alignUp(indexBytes, 4);
+
+	for (unsigned int i = 0; i < arenas.size(); i++) {
+		Arena& arena = arenas[i];
+		if (arena.layout != layout)
+			continue;
+
+		allocation.firstVertex = arena.vertices.allocate(vertexCount);
+		if (allocation.firstVertex == RangeAllocator::NONE)
+			continue;
+
+		// 4 byte aligned, so 16 and 32 bit index ranges can share the buffer
+		allocation.indexOffset = arena.indices.allocate(indexRange, 4);
+		if (allocation.indexOffset == RangeAllocator::NONE) {
+			arena.vertices.release(allocation.firstVertex, vertexCount);
+			continue;
+		}
+
+		allocation.arena = i;
+		break;
+	}
+
+	if (allocation.indexOffset == RangeAllocator::NONE) {
+		allocation.arena = createArena(layout, vertexCount, indexBytes);
+		allocation.firstVertex = arenas[allocation.arena].vertices.allocate(vertexCount);
+		allocation.indexOffset = arenas[allocation.arena].indices.allocate(indexRange, 4);
+	}
+
+	// the copy targets leave the VAO's element buffer binding alone
+	Arena& arena = arenas[allocation.arena];
+	const size_t stride = vertexStride(layout);
+	glState.bindBuffer(GL_COPY_WRITE_BUFFER, arena.vertexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstVertex * stride, vertexCount * stride, vertices);
+	glState.bindBuffer(GL_COPY_WRITE_BUFFER, arena.indexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.indexOffset, indexBytes, indices);
+
+	GeometryHandle handle;
+	if (!freeHandles.empty()) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle] = allocation;
+	}
+	else {
+		handle = (GeometryHandle)allocations.size();
+		allocations.push_back(allocation);
+	}
+
+	return handle;
+}
+
+void GeometryBuffer::release(GeometryHandle handle)
+{
+	if (handle == NO_GEOMETRY || !allocations[handle].live)
+		return;
+
+	Allocation& allocation = allocations[handle];
+	Arena& arena = arenas[allocation.arena];
+	arena.vertices.release(allocation.firstVertex, allocation.vertexCount);
+	arena.indices.release(allocation.indexOffset, alignUp(allocation.indexBytes, 4));
+
+	allocation.live = false;
+	freeHandles.push_back(handle);
+}
+
+GeometryRange GeometryBuffer::range(GeometryHandle handle) const
+{
+	const Allocation& allocation = allocations[handle];
+	return GeometryRange{ arenas[allocation.arena].vao, (GLint)allocation.firstVertex, allocation.indexOffset };
+}
+
+void GeometryBuffer::bindInstances(GeometryHandle handle, GLuint instanceBuffer)
+{
+	Arena& arena = arenas[allocations[handle].arena];
+	if (arena.instanceBuffer == instanceBuffer)
+		return;
+
+	glState.bindVertexArray(arena.vao);
+	glState.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+	// model matrix, one vec4 column per location
+	for (unsigned int column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, Model) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(3 + column, 1);
+	}
+	// normal matrix, one vec3 column per location
+	for (unsigned int column = 0; column < 3; column++) {
+		glEnableVertexAttribArray(7 + column);
+		glVertexAttribPointer(7 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, Normal) + column * sizeof(glm::vec3)));
+		glVertexAttribDivisor(7 + column, 1);
+	}
+
+	arena.instanceBuffer = instanceBuffer;
+}
+
+// ---------------------------------------------------------------------------------------------- Defragmentation
+// Sources always end above their destination hole, so the copy never overlaps itself.
+static void copyWithin(GLuint buffer, size_t from, size_t to, size_t bytes)
+{
+	glState.bindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from, to, bytes);
+}
+
+size_t GeometryBuffer::compactVertices(unsigned int arenaIndex)
+{
+	Arena& arena = arenas[arenaIndex];
+	if (arena.vertices.isCompact())
+		return 0;
+
+	std::vector<Allocation*> candidates;
+	for (Allocation& allocation : allocations) {
+		if (allocation.live && allocation.arena == arenaIndex && allocation.vertexCount > 0)
+			candidates.push_back(&allocation);
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Allocation* a, const Allocation* b) { return a->firstVertex > b->firstVertex; });
+
+	const size_t stride = vertexStride(arena.layout);
+	for (Allocation* allocation : candidates) {
+		size_t target = arena.vertices.allocateBelow(allocation->vertexCount, allocation->firstVertex);
+		if (target == RangeAllocator::NONE)
+			continue;
+
+		// base vertex draws index relative to the first vertex, the indices need no rewrite
+		copyWithin(arena.vertexBuffer, allocation->firstVertex * stride, target * stride, allocation->vertexCount * stride);
+		arena.vertices.release(allocation->firstVertex, allocation->vertexCount);
+		allocation->firstVertex = target;
+		return allocation->vertexCount * stride;
+	}
+
+	return 0;
+}
+
+size_t GeometryBuffer::compactIndices(unsigned int arenaIndex)
+{
+	Arena& arena = arenas[arenaIndex];
+	if (arena.indices.isCompact())
+		return 0;
+
+	std::vector<Allocation*> candidates;
+	for (Allocation& allocation : allocations) {
+		if (allocation.live && allocation.arena == arenaIndex && allocation.indexBytes > 0)
+			candidates.push_back(&allocation);
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Allocation* a, const Allocation* b) { return a->indexOffset > b->indexOffset; });
+
+	for (Allocation* allocation : candidates) {
+		size_t indexRange = alignUp(allocation->indexBytes, 4);
+		size_t target = arena.indices.allocateBelow(indexRange, allocation->indexOffset, 4);
+		if (target == RangeAllocator::NONE)
+			continue;
+
+		copyWithin(arena.indexBuffer, allocation->indexOffset, target, allocation->indexBytes);
+		arena.indices.release(allocation->indexOffset, indexRange);
+		allocation->indexOffset = target;
+		return allocation->indexBytes;
+	}
+
+	return 0;
+}
+
+void GeometryBuffer::defragment(size_t maxBytes)
+{
+	size_t moved = 0;
+	for (unsigned int arena = 0; arena < arenas.size() && moved < maxBytes; arena++) {
+		while (moved < maxBytes) {
+			size_t copied = compactVertices(arena);
+			if (copied == 0)
+				break;
+			moved += copied;
+		}
+		while (moved < maxBytes) {
+			size_t copied = compactIndices(arena);
+			if (copied == 0)
+				break;
+			moved += copied;
+		}
+	}
+
+	bytesMoved += moved;
+}
+
+// ---------------------------------------------------------------------------------------------- Statistics
+GeometryStats GeometryBuffer::getStats() const
+{
+	GeometryStats stats;
+	stats.arenas = arenas.size();
+	stats.allocations = allocations.size() - freeHandles.size();
+	stats.bytesMoved = bytesMoved;
+
+	float fragmentation = 0.0f;
+	int fragmentationSamples = 0;
+	auto sample = [&](const RangeAllocator& allocator) {
+		size_t free = allocator.capacity() - allocator.used();
+		if (free == 0)
+			return;
+		fragmentation += 1.0f - (float)allocator.largestFreeBlock() / (float)free;
+		fragmentationSamples++;
+	};
+
+	for (const Arena& arena : arenas) {
+		const size_t stride = vertexStride(arena.layout);
+		stats.vertexCapacity += arena.vertices.capacity() * stride;
+		stats.vertexUsed += arena.vertices.used() * stride;
+		stats.indexCapacity += arena.indices.capacity();
+		stats.indexUsed += arena.indices.used();
+		stats.freeBlocks += arena.vertices.freeBlockCount() + arena.indices.freeBlockCount();
+
+		sample(arena.vertices);
+		sample(arena.indices);
+	}
+
+	if (fragmentationSamples > 0)
+		stats.fragmentation = fragmentation / fragmentationSamples;
+	return stats;
+}
+
+GeometryBuffer& geometryBuffer()
+{
+	static GeometryBuffer buffer;
+	return buffer;
+}
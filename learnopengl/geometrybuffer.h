@@ -0,0 +1,147 @@
+#ifndef GEOMETRYBUFFER_H
+#define GEOMETRYBUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+enum VertexLayout {
+	LAYOUT_PACKED = 0,	// PackedVertex
+	LAYOUT_FLOAT = 1,	// Vertex
+	LAYOUT_COUNT
+};
+
+// Default arena sizes. A mesh bigger than that gets an arena of its own size.
+const size_t GEOMETRY_ARENA_VERTEX_BYTES = 32 * 1024 * 1024;
+const size_t GEOMETRY_ARENA_INDEX_BYTES = 16 * 1024 * 1024;
+
+// ---------------------------------------------------------------------------------------------- Range Allocator
+// Free list over [0, capacity), kept sorted by offset so neighbours merge on release. Allocation is
+// best fit, which keeps the big blocks whole for big meshes. CPU only, units are up to the caller.
+class RangeAllocator {
+public:
+	static const size_t NONE = ~(size_t)0;
+
+	explicit RangeAllocator(size_t capacity = 0);
+
+	// NONE when no free block fits.
+	size_t allocate(size_t size, size_t alignment = 1);
+	// Only blocks ending at or before limit, for moving an allocation further down.
+	size_t allocateBelow(size_t size, size_t limit, size_t alignment = 1);
+	void release(size_t offset, size_t size);
+
+	size_t capacity() const { return total; }
+	size_t used() const { return total - freeSize; }
+	size_t freeBlockCount() const { return freeBlocks.size(); }
+	size_t largestFreeBlock() const;
+	// All free space is one block at the end, nothing to gain from moving allocations.
+	bool isCompact() const;
+
+private:
+	// offset -> size
+	std::map<size_t, size_t> freeBlocks;
+	size_t total;
+	size_t freeSize;
+};
+
+// ---------------------------------------------------------------------------------------------- Geometry Buffer
+typedef unsigned int GeometryHandle;
+const GeometryHandle NO_GEOMETRY = ~0u;
+
+// Where a mesh lives. Defragmentation moves it, so look it up again for every draw.
+struct GeometryRange {
+	GLuint vao;
+	GLint baseVertex;
+	size_t indexOffset;	// bytes into the arena's element buffer
+};
+
+// The record glDrawElementsIndirect and glMultiDrawElementsIndirect read per draw.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;	// in indices, not bytes
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+struct GeometryStats {
+	size_t arenas = 0;
+	size_t allocations = 0;
+	size_t vertexCapacity = 0;	// bytes
+	size_t vertexUsed = 0;
+	size_t indexCapacity = 0;
+	size_t indexUsed = 0;
+	size_t freeBlocks = 0;
+	// 1 - largest free block / free space, per arena buffer, averaged. 0 when all free space is one block.
+	float fragmentation = 0.0f;
+	size_t bytesMoved = 0;	// by defragment() since the last resetStats()
+};
+
+// Every mesh's vertices and indices live in a few large arenas, one vertex and one element buffer
+// each with a VAO set up for the layout. Meshes sharing an arena share the VAO and are drawn with
+// glDrawElementsBaseVertex, so switching between them binds nothing.
+class GeometryBuffer {
+public:
+	// The GL objects are left to the context, this lives until after it is gone.
+	GeometryBuffer() {}
+
+	GeometryBuffer(const GeometryBuffer&) = delete;
+	GeometryBuffer& operator=(const GeometryBuffer&) = delete;
+
+	// Copies the data into an arena of the layout with room for it, making one when none has.
+	GeometryHandle allocate(VertexLayout layout, const void* vertices, size_t vertexCount, const void* indices, size_t indexBytes);
+	void release(GeometryHandle handle);
+
+	GeometryRange range(GeometryHandle handle) const;
+
+	// Points the instance attributes of the handle's VAO at a buffer of InstanceData. Meshes share
+	// the VAO, so this is tracked per arena rather than per mesh.
+	void bindInstances(GeometryHandle handle, GLuint instanceBuffer);
+
+	// Moves allocations from the end of each arena into holes further down, copying at most about
+	// maxBytes on the GPU. Meant to run a little every frame.
+	void defragment(size_t maxBytes);
+
+	GeometryStats getStats() const;
+	void resetStats() { bytesMoved = 0; }
+
+private:
+	struct Arena {
+		VertexLayout layout;
+		GLuint vao;
+		GLuint vertexBuffer;
+		GLuint indexBuffer;
+		RangeAllocator vertices;	// in vertices
+		RangeAllocator indices;		// in bytes
+		GLuint instanceBuffer;
+	};
+
+	struct Allocation {
+		unsigned int arena;
+		size_t firstVertex;
+		size_t vertexCount;
+		size_t indexOffset;
+		size_t indexBytes;
+		bool live;
+	};
+
+	std::vector<Arena> arenas;
+	std::vector<Allocation> allocations;
+	std::vector<GeometryHandle> freeHandles;
+	size_t bytesMoved = 0;
+
+	unsigned int createArena(VertexLayout layout, size_t vertexCount, size_t indexBytes);
+	// Moves the highest allocation in the arena's vertex or index buffer that fits a lower hole into
+	// it. Returns the bytes copied, 0 when nothing could move.
+	size_t compactVertices(unsigned int arena);
+	size_t compactIndices(unsigned int arena);
+};
+
+size_t vertexStride(VertexLayout layout);
+
+// Shared by every mesh, created on first use. Needs the GL context.
+GeometryBuffer& geometryBuffer();
+
+#endif //GEOMETRYBUFFER_H
@@ -0,0 +1,89 @@
+#include "glextensions.h"
+
+#include <cstring>
+
+int GLEXT_ARB_get_program_binary = 0;
+PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary = NULL;
+PFNGLPROGRAMBINARYPROC glext_glProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri = NULL;
+
+int GLEXT_KHR_parallel_shader_compile = 0;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR = NULL;
+
+int GLEXT_EXT_texture_compression_s3tc = 0;
+
+int GLEXT_ARB_multi_draw_indirect = 0;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glext_glMultiDrawElementsIndirect = NULL;
+
+int GLEXT_ARB_compute_shader = 0;
+PFNGLDISPATCHCOMPUTEPROC glext_glDispatchCompute = NULL;
+PFNGLMEMORYBARRIERPROC glext_glMemoryBarrier = NULL;
+PFNGLDRAWELEMENTSINDIRECTPROC glext_glDrawElementsIndirect = NULL;
+
+static bool isVersionAtLeast(int major, int minor)
+{
+	GLint contextMajor = 0;
+	GLint contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+bool hasGLExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+	for (GLint i = 0; i < count; i++) {
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+void loadGLExtensions(GLADloadproc load)
+{
+	if (isVersionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+		glext_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+		glext_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+		glext_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+		// a driver without binary formats accepts the calls but can never load anything back
+		GLEXT_ARB_get_program_binary = glext_glGetProgramBinary && glext_glProgramBinary && glext_glProgramParameteri && formats > 0;
+	}
+
+	if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+
+	GLEXT_KHR_parallel_shader_compile = glext_glMaxShaderCompilerThreadsKHR != NULL;
+	if (GLEXT_KHR_parallel_shader_compile) {
+		// let the driver use as many compiler threads as it supports
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+	GLEXT_EXT_texture_compression_s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+
+	// the shaders stay at #version 330 and enable what they use, so the extensions have to be listed
+	// even where the version includes them
+	if (isVersionAtLeast(4, 3) || hasGLExtension("GL_ARB_multi_draw_indirect"))
+		glext_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+
+	GLEXT_ARB_multi_draw_indirect = glext_glMultiDrawElementsIndirect && hasGLExtension("GL_ARB_shader_draw_parameters")
+		&& hasGLExtension("GL_ARB_shader_storage_buffer_object") && hasGLExtension("GL_ARB_shading_language_420pack");
+
+	if (isVersionAtLeast(4, 3)) {
+		glext_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+		glext_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+		glext_glDrawElementsIndirect = (PFNGLDRAWELEMENTSINDIRECTPROC)load("glDrawElementsIndirect");
+	}
+
+	GLEXT_ARB_compute_shader = glext_glDispatchCompute && glext_glMemoryBarrier && glext_glDrawElementsIndirect;
+}
@@ -0,0 +1,97 @@
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+
+#include <glad/glad.h>
+
+// glad was generated for core 3.3 only. Entry points from newer versions or extensions are
+// loaded here at runtime, and each group may only be used when its GLEXT_ flag is set.
+
+// ---------------------------------------------------------------------------------------------- ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT	0x8257
+#define GL_PROGRAM_BINARY_LENGTH			0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS		0x87FE
+#define GL_PROGRAM_BINARY_FORMATS			0x87FF
+#endif
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+extern int GLEXT_ARB_get_program_binary;
+extern PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glext_glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri;
+#define glGetProgramBinary glext_glGetProgramBinary
+#define glProgramBinary glext_glProgramBinary
+#define glProgramParameteri glext_glProgramParameteri
+
+// ---------------------------------------------------------------------------------------------- KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR	0x91B0
+#define GL_COMPLETION_STATUS_KHR			0x91B1
+#endif
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Also set for the identical ARB_parallel_shader_compile.
+extern int GLEXT_KHR_parallel_shader_compile;
+extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glext_glMaxShaderCompilerThreadsKHR
+
+// ---------------------------------------------------------------------------------------------- EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT		0x83F0
+#endif
+
+// Formats only, uploads go through the core glCompressedTexImage2D.
+extern int GLEXT_EXT_texture_compression_s3tc;
+
+// ---------------------------------------------------------------------------------------------- ARB_multi_draw_indirect
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER						0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER					0x90D2
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT	0x90DF
+#endif
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+// Only set when the shader side is there as well: ARB_shader_draw_parameters for gl_DrawIDARB,
+// ARB_shader_storage_buffer_object and ARB_shading_language_420pack for the per-draw buffer.
+extern int GLEXT_ARB_multi_draw_indirect;
+extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC glext_glMultiDrawElementsIndirect;
+#define glMultiDrawElementsIndirect glext_glMultiDrawElementsIndirect
+
+// ---------------------------------------------------------------------------------------------- ARB_compute_shader
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER					0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT	0x00000001
+#define GL_COMMAND_BARRIER_BIT				0x00000040
+#define GL_BUFFER_UPDATE_BARRIER_BIT		0x00000200
+#define GL_SHADER_STORAGE_BARRIER_BIT		0x00002000
+#endif
+
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint numGroupsX, GLuint numGroupsY, GLuint numGroupsZ);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect);
+
+// Set on GL 4.3 contexts, whose compute shaders are #version 430 with storage buffers and
+// glDrawElementsIndirect built in.
+extern int GLEXT_ARB_compute_shader;
+extern PFNGLDISPATCHCOMPUTEPROC glext_glDispatchCompute;
+extern PFNGLMEMORYBARRIERPROC glext_glMemoryBarrier;
+extern PFNGLDRAWELEMENTSINDIRECTPROC glext_glDrawElementsIndirect;
+#define glDispatchCompute glext_glDispatchCompute
+#define glMemoryBarrier glext_glMemoryBarrier
+#define glDrawElementsIndirect glext_glDrawElementsIndirect
+
+// ----------------------------------------------------------------------------------------------
+// Call once after gladLoadGLLoader with the same loader.
+void loadGLExtensions(GLADloadproc load);
+bool hasGLExtension(const char* name);
+
+#endif //GLEXTENSIONS_H
@@ -0,0 +1,193 @@
+#include "glstate.h"
+
+StateCache glState;
+
+static const GLuint UNKNOWN_NAME = ~0u;
+static const int UNKNOWN_FLAG = -1;
+
+StateCache::StateCache()
+{
+	invalidate();
+}
+
+void StateCache::invalidate()
+{
+	program = UNKNOWN_NAME;
+	vao = UNKNOWN_NAME;
+	activeUnit = UNKNOWN_NAME;
+	for (int i = 0; i < MAX_TRACKED_TEXTURE_UNITS; i++)
+		textures[i] = TextureBinding{ 0, UNKNOWN_NAME };
+	bufferCount = 0;
+
+	polygonModeValue = 0;
+	depthTest = UNKNOWN_FLAG;
+	depthWrite = UNKNOWN_FLAG;
+	depthFuncValue = 0;
+	colorWrite = UNKNOWN_FLAG;
+	blend = UNKNOWN_FLAG;
+	blendSource = 0;
+	blendDestination = 0;
+}
+
+bool StateCache::changed(bool differs)
+{
+	if (differs)
+		counters.issued++;
+	else
+		counters.filtered++;
+
+	return differs;
+}
+
+StateCache::BufferBinding& StateCache::bufferSlot(GLenum target)
+{
+	for (int i = 0; i < bufferCount; i++) {
+		if (buffers[i].target == target)
+			return buffers[i];
+	}
+
+	if (bufferCount == MAX_TRACKED_BUFFER_TARGETS)
+		bufferCount--;
+
+	buffers[bufferCount] = BufferBinding{ target, UNKNOWN_NAME };
+	return buffers[bufferCount++];
+}
+
+// ---------------------------------------------------------------------------------------------- Objects
+void StateCache::useProgram(GLuint program)
+{
+	if (changed(this->program != program)) {
+		glUseProgram(program);
+		this->program = program;
+	}
+}
+
+void StateCache::bindVertexArray(GLuint vao)
+{
+	if (changed(this->vao != vao)) {
+		glBindVertexArray(vao);
+		this->vao = vao;
+
+		// the element buffer binding belongs to the vertex array
+		bufferSlot(GL_ELEMENT_ARRAY_BUFFER).buffer = UNKNOWN_NAME;
+	}
+}
+
+void StateCache::activeTexture(unsigned int unit)
+{
+	if (changed(activeUnit != unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+}
+
+void StateCache::bindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+	if (unit >= MAX_TRACKED_TEXTURE_UNITS) {
+		counters.issued += 2;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		activeUnit = unit;
+		return;
+	}
+
+	TextureBinding& binding = textures[unit];
+	if (binding.target == target && binding.texture == texture) {
+		counters.filtered++;
+		return;
+	}
+
+	activeTexture(unit);
+	counters.issued++;
+	glBindTexture(target, texture);
+	binding = TextureBinding{ target, texture };
+}
+
+void StateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	BufferBinding& binding = bufferSlot(target);
+	if (changed(binding.buffer != buffer)) {
+		glBindBuffer(target, buffer);
+		binding.buffer = buffer;
+	}
+}
+
+void StateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	// indexed bindings are not tracked, but the call also replaces the generic binding
+	counters.issued++;
+	glBindBufferBase(target, index, buffer);
+	bufferSlot(target).buffer = buffer;
+}
+
+void StateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	counters.issued++;
+	glBindBufferRange(target, index, buffer, offset, size);
+	bufferSlot(target).buffer = buffer;
+}
+
+// ---------------------------------------------------------------------------------------------- Fixed Function
+void StateCache::polygonMode(GLenum mode)
+{
+	if (changed(polygonModeValue != mode)) {
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+		polygonModeValue = mode;
+	}
+}
+
+void StateCache::setDepthTest(bool enabled)
+{
+	if (changed(depthTest != (int)enabled)) {
+		if (enabled)
+			glEnable(GL_DEPTH_TEST);
+		else
+			glDisable(GL_DEPTH_TEST);
+		depthTest = enabled;
+	}
+}
+
+void StateCache::depthMask(bool enabled)
+{
+	if (changed(depthWrite != (int)enabled)) {
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		depthWrite = enabled;
+	}
+}
+
+void StateCache::depthFunc(GLenum func)
+{
+	if (changed(depthFuncValue != func)) {
+		glDepthFunc(func);
+		depthFuncValue = func;
+	}
+}
+
+void StateCache::colorMask(bool enabled)
+{
+	if (changed(colorWrite != (int)enabled)) {
+		GLboolean value = enabled ? GL_TRUE : GL_FALSE;
+		glColorMask(value, value, value, value);
+		colorWrite = enabled;
+	}
+}
+
+void StateCache::setBlend(bool enabled)
+{
+	if (changed(blend != (int)enabled)) {
+		if (enabled)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+		blend = enabled;
+	}
+}
+
+void StateCache::blendFunc(GLenum source, GLenum destination)
+{
+	if (changed(blendSource != source || blendDestination != destination)) {
+		glBlendFunc(source, destination);
+		blendSource = source;
+		blendDestination = destination;
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+const int MAX_TRACKED_TEXTURE_UNITS = 32;
+const int MAX_TRACKED_BUFFER_TARGETS = 12;
+
+struct StateCounters {
+	unsigned long long issued = 0;
+	unsigned long long filtered = 0;
+	unsigned long long draws = 0;
+};
+
+// Shadow of the GL state the engine touches. Every bind goes through here and is only forwarded
+// to GL when it actually changes something. Code that calls GL directly behind its back has to
+// call invalidate() afterwards.
+class StateCache {
+public:
+	StateCache();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void activeTexture(unsigned int unit);
+	void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	// Always GL_FRONT_AND_BACK, the only face core profile accepts.
+	void polygonMode(GLenum mode);
+	GLenum getPolygonMode() const { return polygonModeValue != 0 ? polygonModeValue : GL_FILL; }
+
+	void setDepthTest(bool enabled);
+	void depthMask(bool enabled);
+	void depthFunc(GLenum func);
+	void colorMask(bool enabled);
+	void setBlend(bool enabled);
+	void blendFunc(GLenum source, GLenum destination);
+
+	// Forget everything, the next call of each kind is always issued.
+	void invalidate();
+
+	// Draw calls are issued directly, this only keeps count of them.
+	void countDraw() { counters.draws++; }
+
+	const StateCounters& getCounters() const { return counters; }
+	void resetCounters() { counters = StateCounters(); }
+
+private:
+	struct BufferBinding {
+		GLenum target;
+		GLuint buffer;
+	};
+
+	struct TextureBinding {
+		GLenum target;
+		GLuint texture;
+	};
+
+	GLuint program;
+	GLuint vao;
+	unsigned int activeUnit;
+	TextureBinding textures[MAX_TRACKED_TEXTURE_UNITS];
+	BufferBinding buffers[MAX_TRACKED_BUFFER_TARGETS];
+	int bufferCount;
+
+	GLenum polygonModeValue;
+	int depthTest;
+	int depthWrite;
+	GLenum depthFuncValue;
+	int colorWrite;
+	int blend;
+	GLenum blendSource;
+	GLenum blendDestination;
+
+	StateCounters counters;
+
+	// true when the call has to reach GL, and counts it either way
+	bool changed(bool differs);
+	BufferBinding& bufferSlot(GLenum target);
+};
+
+extern StateCache glState;
+
+#endif //GLSTATE_H
@@ -0,0 +1,190 @@
+#include "gpuculling.h"
+#include "glextensions.h"
+#include "glstate.h"
+#include "drawmatrices.h"
+
+#include <algorithm>
+#include <string>
+
+static_assert(sizeof(InstanceData) == 25 * sizeof(float), "cull_instances.comp copies InstanceData as 25 floats");
+
+const GLuint CULL_GROUP_SIZE = 64;
+
+GpuCuller::GpuCuller()
+{
+	cullShader.reset(new Shader(ShaderSource::fromComputeFile("resources/shaders/cull_instances.comp")));
+	finalizeShader.reset(new Shader(ShaderSource::fromComputeFile("resources/shaders/cull_instances.comp"), { { "FINALIZE", "" } }));
+
+	instanceCountHandle = cullShader->uniform<int>("instanceCount");
+	for (int plane = 0; plane < PLANE_COUNT; plane++)
+		planeHandles[plane] = cullShader->uniform<glm::vec4>("planes[" + std::to_string(plane) + "]");
+	viewProjectionHandle = cullShader->uniform<glm::mat4>("viewProjection");
+	hiZEnabledHandle = cullShader->uniform<bool>("hiZEnabled");
+	hiZHandle = cullShader->uniform<int>("hiZ");
+	hiZLevelsHandle = cullShader->uniform<int>("hiZLevels");
+	commandCountHandle = finalizeShader->uniform<int>("commandCount");
+
+	glGenBuffers(1, &instanceBuffer);
+	glGenBuffers(1, &boundsBuffer);
+	glGenBuffers(1, &commandBuffer);
+	glGenBuffers(1, &visibleBuffer);
+	glGenBuffers(1, &visibilityBuffer);
+
+	// the pyramid keeps the occlusion buffer's size, only the contents change every frame
+	hiZLevels = 1;
+	while ((OCCLUSION_WIDTH >> hiZLevels) > 0 || (OCCLUSION_HEIGHT >> hiZLevels) > 0)
+		hiZLevels++;
+
+	glGenTextures(1, &hiZTexture);
+	glState.bindTexture(0, GL_TEXTURE_2D, hiZTexture);
+	hiZ.resize(hiZLevels);
+	for (int level = 0; level < hiZLevels; level++) {
+		int width = std::max(1, OCCLUSION_WIDTH >> level);
+		int height = std::max(1, OCCLUSION_HEIGHT >> level);
+		hiZ[level].assign((size_t)width * height, 1.0f);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hiZLevels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+GpuCuller::~GpuCuller()
+{
+	GLuint buffers[] = { instanceBuffer, boundsBuffer, commandBuffer, visibleBuffer, visibilityBuffer };
+	glDeleteBuffers(5, buffers);
+	glDeleteTextures(1, &hiZTexture);
+	// deleting unbinds them, and GL may hand the same names out again
+	glState.invalidate();
+}
+
+void GpuCuller::setInstances(const Model& model, const std::vector<glm::mat4>& models)
+{
+	count = models.size();
+
+	std::vector<InstanceData> instances(count);
+	std::vector<glm::vec4> bounds(count * 2);
+	for (size_t i = 0; i < count; i++) {
+		instances[i].Model = models[i];
+		instances[i].Normal = normalMatrix(models[i]);
+
+		AABB box = model.getBounds().transformed(models[i]);
+		bounds[i * 2] = glm::vec4(box.min, 0.0f);
+		bounds[i * 2 + 1] = glm::vec4(box.max, 0.0f);
+	}
+
+	// never empty, binding a buffer without a store fails
+	size_t stored = std::max<size_t>(count, 1);
+	glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, stored * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+	glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, stored * 2 * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+	glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, stored * sizeof(InstanceData), NULL, GL_DYNAMIC_COPY);
+	glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, stored * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+}
+
+void GpuCuller::setOcclusion(const OcclusionCuller* occlusion)
+{
+	hiZEnabled = occlusion && occlusion->isRendered();
+	if (!hiZEnabled)
+		return;
+
+	// each texel of a level is the farthest of the up to 2x2 texels below it
+	hiZ[0] = occlusion->getDepth();
+	for (int level = 1; level < hiZLevels; level++) {
+		int width = std::max(1, OCCLUSION_WIDTH >> level);
+		int height = std::max(1, OCCLUSION_HEIGHT >> level);
+		int belowWidth = std::max(1, OCCLUSION_WIDTH >> (level - 1));
+		int belowHeight = std::max(1, OCCLUSION_HEIGHT >> (level - 1));
+		const std::vector<float>& below = hiZ[level - 1];
+
+		for (int y = 0; y < height; y++) {
+			int y0 = std::min(y * 2, belowHeight - 1);
+			int y1 = std::min(y * 2 + 1, belowHeight - 1);
+			for (int x = 0; x < width; x++) {
+				int x0 = std::min(x * 2, belowWidth - 1);
+				int x1 = std::min(x * 2 + 1, belowWidth - 1);
+				hiZ[level][y * width + x] = std::max(std::max(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+					std::max(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+			}
+		}
+	}
+
+	glState.bindTexture(0, GL_TEXTURE_2D, hiZTexture);
+	for (int level = 0; level < hiZLevels; level++) {
+		int width = std::max(1, OCCLUSION_WIDTH >> level);
+		int height = std::max(1, OCCLUSION_HEIGHT >> level);
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RED, GL_FLOAT, hiZ[level].data());
+	}
+}
+
+void GpuCuller::cull(const Model& model, const glm::mat4& viewProjection)
+{
+	// meshes may have moved in the geometry buffer, so the commands are rewritten every frame
+	std::vector<DrawElementsIndirectCommand> commands = model.indirectCommands();
+	commandCount = commands.size();
+	if (commands.empty())
+		commands.push_back({ 0, 0, 0, 0, 0 });
+
+	glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_COPY);
+
+	glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_INSTANCES, instanceBuffer);
+	glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_BOUNDS, boundsBuffer);
+	glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_COMMANDS, commandBuffer);
+	glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_VISIBLE, visibleBuffer);
+	glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_VISIBILITY, visibilityBuffer);
+
+	Frustum frustum = Frustum::fromMatrix(viewProjection);
+	cullShader->use();
+	cullShader->set(instanceCountHandle, (int)count);
+	for (int plane = 0; plane < PLANE_COUNT; plane++)
+		cullShader->set(planeHandles[plane], frustum.planes[plane]);
+	cullShader->set(viewProjectionHandle, viewProjection);
+	cullShader->set(hiZEnabledHandle, hiZEnabled);
+	cullShader->set(hiZHandle, 0);
+	cullShader->set(hiZLevelsHandle, hiZLevels);
+	cullShader->flush();
+	glState.bindTexture(0, GL_TEXTURE_2D, hiZTexture);
+	glDispatchCompute((GLuint)((count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+
+	// the first command holds the count, the others copy it once every instance is in
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	finalizeShader->use();
+	finalizeShader->set(commandCountHandle, (int)commandCount);
+	finalizeShader->flush();
+	glDispatchCompute((GLuint)((commandCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void GpuCuller::draw(Model& model, Shader& instancedShader)
+{
+	if (commandCount == 0)
+		return;
+
+	glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	model.DrawIndirect(instancedShader, visibleBuffer);
+}
+
+std::vector<uint8_t> GpuCuller::readVisibility() const
+{
+	std::vector<GLuint> flags(count);
+	if (count > 0) {
+		glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), flags.data());
+	}
+
+	return std::vector<uint8_t>(flags.begin(), flags.end());
+}
+
+size_t GpuCuller::readVisibleCount() const
+{
+	DrawElementsIndirectCommand first = { 0, 0, 0, 0, 0 };
+	glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(first), &first);
+
+	return first.instanceCount;
+}
@@ -0,0 +1,84 @@
+#ifndef GPUCULLING_H
+#define GPUCULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+#include "occlusion.h"
+#include "shader.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Storage buffer bindings of cull_instances.comp.
+enum GpuCullBinding {
+	GPU_CULL_INSTANCES	= 0,
+	GPU_CULL_BOUNDS		= 1,
+	GPU_CULL_COMMANDS	= 2,
+	GPU_CULL_VISIBLE	= 3,
+	GPU_CULL_VISIBILITY	= 4
+};
+
+// Frustum and Hi-Z occlusion culling of many instances of one model in a compute shader. The
+// instances live on the GPU, each frame's pass compacts the visible ones into an instance buffer
+// and writes the instance count into one indirect command per mesh, so the CPU never sees
+// per-instance visibility. The Hi-Z pyramid is built from the OcclusionCuller's depth.
+// Everything here needs GLEXT_ARB_compute_shader.
+class GpuCuller {
+public:
+	GpuCuller();
+	// Deletes the buffers and the Hi-Z texture, the context has to be current.
+	~GpuCuller();
+
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	// Uploads the instances' matrices and world boxes once, they stay until the next call.
+	void setInstances(const Model& model, const std::vector<glm::mat4>& models);
+
+	// Hi-Z test against this frame's occluders, off while the culler has not rendered. NULL turns
+	// it off.
+	void setOcclusion(const OcclusionCuller* occlusion);
+
+	// Culls every instance against the camera and fills the draw commands for the model's meshes.
+	void cull(const Model& model, const glm::mat4& viewProjection);
+	// Draws the survivors of the last cull. Needs a shader built with INSTANCED.
+	void draw(Model& model, Shader& instancedShader);
+
+	size_t instanceCount() const { return count; }
+
+	// Read back from the last cull for tests, they wait for the GPU.
+	// 1 per visible instance and 0 per culled one, in setInstances order.
+	std::vector<uint8_t> readVisibility() const;
+	size_t readVisibleCount() const;
+
+private:
+	std::unique_ptr<Shader> cullShader;
+	std::unique_ptr<Shader> finalizeShader;
+
+	UniformHandle<int> instanceCountHandle;
+	UniformHandle<glm::vec4> planeHandles[PLANE_COUNT];
+	UniformHandle<glm::mat4> viewProjectionHandle;
+	UniformHandle<bool> hiZEnabledHandle;
+	UniformHandle<int> hiZHandle;
+	UniformHandle<int> hiZLevelsHandle;
+	UniformHandle<int> commandCountHandle;
+
+	size_t count = 0;
+	size_t commandCount = 0;
+	GLuint instanceBuffer = 0;
+	GLuint boundsBuffer = 0;
+	GLuint commandBuffer = 0;
+	GLuint visibleBuffer = 0;
+	GLuint visibilityBuffer = 0;
+
+	GLuint hiZTexture = 0;
+	int hiZLevels = 0;
+	bool hiZEnabled = false;
+	// farthest depth of each level, level 0 first
+	std::vector<std::vector<float>> hiZ;
+};
+
+#endif //GPUCULLING_H
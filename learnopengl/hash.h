@@ -0,0 +1,43 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ---------------------------------------------------------------------------------------------- FNV-1a
+// 64 bit FNV-1a, used to key the on-disk caches. Chain calls by passing the previous result as seed.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+inline uint64_t hashString(const std::string& value, uint64_t seed = FNV_OFFSET_BASIS)
+{
+	// include the terminator so ("ab", "c") and ("a", "bc") hash differently
+	return hashBytes(value.c_str(), value.size() + 1, seed);
+}
+
+inline std::string hashToHex(uint64_t hash)
+{
+	const char* digits = "0123456789abcdef";
+	std::string hex(16, '0');
+	for (int i = 15; i >= 0; i--) {
+		hex[i] = digits[hash & 0xF];
+		hash >>= 4;
+	}
+
+	return hex;
+}
+
+#endif //HASH_H
@@ -0,0 +1,311 @@
+#include "indexoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// ---------------------------------------------------------------------------------------------- Statistics
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = { 0, 0.0f, 0.0f };
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	// a vertex is in the FIFO while fewer than cacheSize misses happened since it entered
+	std::vector<unsigned int> insertedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int misses = 0;
+	size_t usedCount = 0;
+
+	for (size_t i = 0; i < indexCount; i++) {
+		unsigned int vertex = indices[i];
+		if (!used[vertex]) {
+			used[vertex] = true;
+			usedCount++;
+		}
+		else if (misses - insertedAt[vertex] < cacheSize) {
+			continue;
+		}
+
+		insertedAt[vertex] = misses;
+		misses++;
+	}
+
+	stats.transformed = misses;
+	stats.acmr = (float)misses / (float)(indexCount / 3);
+	stats.atvr = (float)misses / (float)usedCount;
+	return stats;
+}
+
+// ---------------------------------------------------------------------------------------------- Vertex Cache
+// the scoring assumes a larger LRU cache than the FIFO, as in the original paper
+static const int SCORING_CACHE_SIZE = 32;
+
+static float vertexScore(int cachePosition, unsigned int liveTriangles)
+{
+	// nothing left to draw with it
+	if (liveTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// the last triangle's vertices score the same, so the next one is not biased towards an edge
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.0f - (float)(cachePosition - 3) / (float)(SCORING_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// vertices with few triangles left are finished first, instead of leaving them stranded
+	return score + 2.0f / std::sqrt((float)liveTriangles);
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// triangles around each vertex, the first liveTriangles[v] of them still to be drawn
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[filled[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> output(triangleCount * 3);
+
+	unsigned int cache[SCORING_CACHE_SIZE + 3];
+	unsigned int nextCache[SCORING_CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	size_t cursor = 0;
+	long long best = -1;
+	for (size_t out = 0; out < triangleCount; out++) {
+		// nothing in the cache has triangles left, carry on with the first one not drawn yet
+		if (best < 0) {
+			while (emitted[cursor])
+				cursor++;
+			best = (long long)cursor;
+		}
+
+		const unsigned int* triangle = indices + best * 3;
+		std::memcpy(&output[out * 3], triangle, 3 * sizeof(unsigned int));
+		emitted[best] = true;
+
+		for (int k = 0; k < 3; k++) {
+			unsigned int vertex = triangle[k];
+			unsigned int* around = &adjacency[offsets[vertex]];
+			unsigned int* last = around + liveTriangles[vertex] - 1;
+			*std::find(around, last + 1, (unsigned int)best) = *last;
+			liveTriangles[vertex]--;
+		}
+
+		// the triangle's vertices move to the front, the rest shift back and may fall out
+		int nextCount = 0;
+		for (int k = 0; k < 3; k++) {
+			if (std::find(nextCache, nextCache + nextCount, triangle[k]) == nextCache + nextCount)
+				nextCache[nextCount++] = triangle[k];
+		}
+		for (int i = 0; i < cacheCount; i++) {
+			if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+				nextCache[nextCount++] = cache[i];
+		}
+
+		// triangle scores are sums of vertex scores, so each vertex passes on the change of its own
+		for (int i = 0; i < nextCount; i++) {
+			unsigned int vertex = nextCache[i];
+			cachePosition[vertex] = i < SCORING_CACHE_SIZE ? i : -1;
+
+			float score = vertexScore(cachePosition[vertex], liveTriangles[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const unsigned int* around = &adjacency[offsets[vertex]];
+			for (unsigned int j = 0; j < liveTriangles[vertex]; j++)
+				triangleScores[around[j]] += delta;
+		}
+
+		cacheCount = std::min(nextCount, SCORING_CACHE_SIZE);
+		std::memcpy(cache, nextCache, cacheCount * sizeof(unsigned int));
+
+		// only triangles touching the cache can be the best next one
+		best = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < cacheCount; i++) {
+			const unsigned int* around = &adjacency[offsets[cache[i]]];
+			for (unsigned int j = 0; j < liveTriangles[cache[i]]; j++) {
+				if (triangleScores[around[j]] > bestScore) {
+					bestScore = triangleScores[around[j]];
+					best = around[j];
+				}
+			}
+		}
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+// ---------------------------------------------------------------------------------------------- Overdraw
+struct Cluster {
+	size_t first;
+	size_t count;
+	float centroid[3];
+	float normal[3];
+	float area;
+	float sortKey;
+};
+
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t stride, float threshold)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	auto position = [&](unsigned int vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * stride);
+	};
+
+	const float meshAcmr = analyzeVertexCache(indices, triangleCount * 3, vertexCount).acmr;
+
+	// a triangle with no vertex in the cache starts a new region of the list, the list can be cut there
+	// when the cluster so far kept its cache efficiency
+	std::vector<Cluster> clusters;
+	{
+		std::vector<unsigned int> insertedAt(vertexCount, 0);
+		std::vector<bool> seen(vertexCount, false);
+		unsigned int misses = 0;
+		unsigned int clusterMisses = 0;
+		size_t clusterStart = 0;
+
+		for (size_t t = 0; t < triangleCount; t++) {
+			unsigned int triangleMisses = 0;
+			for (int k = 0; k < 3; k++) {
+				unsigned int vertex = indices[t * 3 + k];
+				if (seen[vertex] && misses - insertedAt[vertex] < VERTEX_CACHE_SIZE)
+					continue;
+				seen[vertex] = true;
+				insertedAt[vertex] = misses++;
+				triangleMisses++;
+			}
+
+			size_t clusterTriangles = t - clusterStart;
+			if (triangleMisses == 3 && clusterTriangles > 0 && (float)clusterMisses / clusterTriangles <= meshAcmr * threshold) {
+				clusters.push_back({ clusterStart, clusterTriangles, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f });
+				clusterStart = t;
+				clusterMisses = 0;
+			}
+			clusterMisses += triangleMisses;
+		}
+		clusters.push_back({ clusterStart, triangleCount - clusterStart, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f });
+	}
+
+	if (clusters.size() < 2)
+		return;
+
+	// area weighted centroids, the cross products' lengths are twice the areas
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (Cluster& cluster : clusters) {
+		float* centroid = cluster.centroid;
+		float* normal = cluster.normal;
+		float& area = cluster.area;
+
+		for (size_t t = cluster.first; t < cluster.first + cluster.count; t++) {
+			const float* a = position(indices[t * 3]);
+			const float* b = position(indices[t * 3 + 1]);
+			const float* p = position(indices[t * 3 + 2]);
+
+			float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+			float cross[3] = { ab[1] * ap[2] - ab[2] * ap[1], ab[2] * ap[0] - ab[0] * ap[2], ab[0] * ap[1] - ab[1] * ap[0] };
+			float weight = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+			for (int axis = 0; axis < 3; axis++) {
+				centroid[axis] += (a[axis] + b[axis] + p[axis]) / 3.0f * weight;
+				normal[axis] += cross[axis];
+			}
+			area += weight;
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+			meshCentroid[axis] += centroid[axis];
+		meshArea += area;
+
+		if (area > 0.0f) {
+			for (int axis = 0; axis < 3; axis++)
+				centroid[axis] /= area;
+		}
+	}
+
+	if (meshArea > 0.0f) {
+		for (int axis = 0; axis < 3; axis++)
+			meshCentroid[axis] /= meshArea;
+	}
+
+	// clusters far out along their own facing direction are most likely to be in front of the others
+	for (Cluster& cluster : clusters) {
+		const float* centroid = cluster.centroid;
+		const float* normal = cluster.normal;
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		float key = 0.0f;
+		if (length > 0.0f) {
+			for (int axis = 0; axis < 3; axis++)
+				key += (centroid[axis] - meshCentroid[axis]) * normal[axis] / length;
+		}
+		cluster.sortKey = key;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (const Cluster& cluster : clusters)
+		output.insert(output.end(), indices + cluster.first * 3, indices + (cluster.first + cluster.count) * 3);
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+// ---------------------------------------------------------------------------------------------- Vertex Fetch
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount)
+{
+	const unsigned int UNUSED = ~0u;
+	std::vector<unsigned int> remap(vertexCount, UNUSED);
+	unsigned int next = 0;
+
+	for (size_t i = 0; i < indexCount; i++) {
+		unsigned int& target = remap[indices[i]];
+		if (target == UNUSED)
+			target = next++;
+		indices[i] = target;
+	}
+
+	unsigned char* bytes = static_cast<unsigned char*>(vertices);
+	std::vector<unsigned char> reordered((size_t)next * vertexSize);
+	for (size_t v = 0; v < vertexCount; v++) {
+		if (remap[v] != UNUSED)
+			std::memcpy(&reordered[remap[v] * vertexSize], bytes + v * vertexSize, vertexSize);
+	}
+
+	std::memcpy(bytes, reordered.data(), reordered.size());
+	return next;
+}
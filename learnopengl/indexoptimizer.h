@@ -0,0 +1,37 @@
+#ifndef INDEXOPTIMIZER_H
+#define INDEXOPTIMIZER_H
+
+#include <cstddef>
+
+// Triangle list reordering for the GPU's post-transform vertex cache, overdraw and vertex fetch.
+// Works on plain index and vertex arrays, nothing here needs a GL context.
+
+// Size of the FIFO cache the statistics simulate, close to what current hardware reuses.
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+	// vertex shader invocations for the whole list
+	unsigned int transformed;
+	// average cache miss ratio: transformed vertices per triangle, 0.5 at best on a regular grid, 3 at worst
+	float acmr;
+	// average transform to vertex ratio: transformed vertices per vertex used, 1 at best
+	float atvr;
+};
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders triangles so that vertices are reused while they are still in the cache (Forsyth's linear
+// speed optimizer). Triangles keep their winding.
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+// Splits a cache optimized list into clusters where that costs little cache efficiency (the cluster
+// ACMR stays within threshold of the whole list), then draws the clusters facing outwards from the
+// mesh centre first, so they hide the rest early (Tipsify's overdraw pass). positions points at the
+// first vertex's x, y, z floats, stride bytes apart.
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t stride, float threshold = 1.05f);
+
+// Puts the vertices in the order the indices first use them and rewrites the indices to match.
+// Unused vertices are dropped; returns how many are left at the front of vertices.
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount);
+
+#endif //INDEXOPTIMIZER_H
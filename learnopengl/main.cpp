@@ -5,6 +5,8 @@
 #include <map>
 #include <functional>
 #include "shader.h"
+#include "glextensions.h"
+#include "glstate.h"
 #include "stb_image.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -14,7 +16,14 @@
 #include <sstream>
 #include <string>
 #include "model.h"
+#include "uniformbuffer.h"
+#include "renderqueue.h"
+#include "scene.h"
+#include "modelloader.h"
+#include "benchmarks.h"
 #include <filesystem>
+#include <cstdlib>
+#include <algorithm>
 
 // ---------------------------------------------------------------------------------------------- Window
 const int SCREEN_WIDTH = 800;
@@ -31,6 +40,15 @@ float cameraFOV = 45.0f;
 
 float cameraSpeed = 2.5f;
 
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+// time the model loader gets each frame for texture uploads and mesh creation
+const double LOADING_BUDGET_MS = 4.0;
+// GPU copies the geometry buffer may spend each frame closing holes left by freed meshes
+const size_t DEFRAGMENT_BUDGET_BYTES = 1024 * 1024;
+// longest frame the loading benchmark accepts unless another one is given after the option
+const double LOADING_STALL_BUDGET_MS = 50.0;
+
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
 // ---------------------------------------------------------------------------------------------- Keymapping
@@ -62,7 +80,37 @@ unsigned int generateCube();
 glm::vec3 lightPos;
 glm::vec3 lightColor;
 
-int main() {
+int main(int argc, char** argv) {
+	std::string option = argc > 1 ? argv[1] : "";
+
+	// CPU only benchmarks run before any window exists
+	if (option == "--bench-culling") {
+		runCullingBenchmark();
+		return 0;
+	}
+	if (option == "--bench-occlusion") {
+		return runOcclusionBenchmark() ? 0 : 1;
+	}
+	if (option == "--bench-meshcache") {
+		return runMeshCacheBenchmark() ? 0 : 1;
+	}
+	if (option == "--bench-indices") {
+		return runIndexOptimizerBenchmark() ? 0 : 1;
+	}
+	if (option == "--bench-quantization") {
+		return runQuantizationBenchmark() ? 0 : 1;
+	}
+	if (option == "--bench-transforms") {
+		return runTransformBenchmark() ? 0 : 1;
+	}
+
+	// decodes textures one after another, to compare model load times with the parallel default
+	if (option == "--serial-textures")
+		Model::parallelTextures = false;
+	// uploads 32 byte float vertices, to compare with the packed default
+	if (option == "--float-vertices")
+		Mesh::packedVertices = false;
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -81,6 +129,14 @@ int main() {
 		std::cout << "Failed to initialize GLAD." << std::endl;
 		return -1;
 	}
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+	TextureCache::compress = GLEXT_EXT_texture_compression_s3tc != 0;
+
+	if (option == "--bench-loading") {
+		bool passed = runLoadingBenchmark(window, argc > 2 ? std::atof(argv[2]) : LOADING_STALL_BUDGET_MS);
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
 
 	glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
@@ -97,14 +153,44 @@ int main() {
 	view = camera.GetViewMatrix();
 
 	glm::mat4 projection;
-	projection = glm::perspective(glm::radians(camera.Zoom), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
+	projection = glm::perspective(glm::radians(camera.Zoom), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
 
-	glEnable(GL_DEPTH_TEST);
+	glState.setDepthTest(true);
 
 	// ---------------------------------------------------------------------------------------------- SHADER
-	Shader shader("resources/shaders/model_loading.vert", "resources/shaders/model_loading.frag");
-	Model backpackModel("resources/models/backpack/backpack.obj");
-	Model robotModel("resources/models/drone_obj/drone.obj");
+	const int sceneLights = 1;
+	ShaderVariants modelShaders("resources/shaders/model_loading.vert", "resources/shaders/model_loading.frag");
+	Shader& shader = modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) } });
+	Shader& flipShader = modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) }, { "FLIP_UV", "" } });
+	Shader& flipAlphaShader = modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) }, { "FLIP_UV", "" }, { "ALPHA_MAP", "" } });
+	Shader lightShader("resources/shaders/lamp.vert", "resources/shaders/lamp.frag");
+
+	// the same programs reading their matrices per draw, for the multi-draw path where the context has it
+	Shader* multiDrawShader = NULL;
+	Shader* multiDrawFlipShader = NULL;
+	Shader* multiDrawFlipAlphaShader = NULL;
+	if (GLEXT_ARB_multi_draw_indirect) {
+		multiDrawShader = &modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) }, { "MULTI_DRAW", "" } });
+		multiDrawFlipShader = &modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) }, { "FLIP_UV", "" }, { "MULTI_DRAW", "" } });
+		multiDrawFlipAlphaShader = &modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) }, { "FLIP_UV", "" }, { "ALPHA_MAP", "" }, { "MULTI_DRAW", "" } });
+	}
+
+	// every program is submitted by now, the driver compiles them while the models load
+	ShaderWarmup warmup;
+	warmup.add(shader);
+	warmup.add(flipShader);
+	warmup.add(flipAlphaShader);
+	warmup.add(lightShader);
+	if (GLEXT_ARB_multi_draw_indirect) {
+		warmup.add(*multiDrawShader);
+		warmup.add(*multiDrawFlipShader);
+		warmup.add(*multiDrawFlipAlphaShader);
+	}
+
+	// the models fill in while the render loop runs, the backpack first
+	ModelLoader modelLoader;
+	std::shared_ptr<Model> backpackModel = modelLoader.load("resources/models/backpack/backpack.obj", 1);
+	std::shared_ptr<Model> robotModel = modelLoader.load("resources/models/drone_obj/drone.obj");
 
 	// ---------------------------------------------------------------------------------------------- KEYS
 	setupKeyMap(window);
@@ -112,8 +198,95 @@ int main() {
 	unsigned int cubeVAO = generateCube();
 	lightPos = glm::vec3(0.5f, 0.5f, 1.0f);
 	lightColor = glm::vec3(1.0f);
-	
-	Shader lightShader("resources/shaders/lamp.vert", "resources/shaders/lamp.frag");
+
+	warmup.wait();
+
+	// ---------------------------------------------------------------------------------------------- UNIFORMS
+	UniformBuffer frameUBO(FRAME_BINDING, sizeof(FrameBlock));
+	UniformBuffer lightsUBO(LIGHTS_BINDING, sizeof(LightsBlock));
+
+	FrameBlock frameData {};
+	LightsBlock lightsData {};
+
+	UniformHandle<glm::mat4> lightMVPHandle		= lightShader.uniform<glm::mat4>("modelViewProjection");
+	UniformHandle<glm::vec3> lightColorHandle	= lightShader.uniform<glm::vec3>("color");
+
+	// ---------------------------------------------------------------------------------------------- BENCHMARKS
+	if (option == "--bench-instancing") {
+		Shader& instancedShader = modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) }, { "INSTANCED", "" } });
+		instancedShader.wait();
+		modelLoader.finish();
+
+		runInstancingBenchmark(window, frameUBO, *backpackModel, shader, instancedShader);
+		glfwTerminate();
+		return 0;
+	}
+	if (option == "--bench-gpuculling") {
+		if (!GLEXT_ARB_compute_shader) {
+			std::cout << "ERROR - BENCHMARK: GPU culling needs compute shaders from a GL 4.3 context." << std::endl;
+			glfwTerminate();
+			return 1;
+		}
+
+		Shader& instancedShader = modelShaders.get({ { "NR_POINT_LIGHTS", std::to_string(sceneLights) }, { "INSTANCED", "" } });
+		instancedShader.wait();
+		modelLoader.finish();
+
+		bool passed = runGpuCullingBenchmark(window, frameUBO, *backpackModel, instancedShader);
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+	if (option == "--bench-vertex") {
+		modelLoader.finish();
+
+		bool passed = runVertexTransformBenchmark(window, frameUBO, *backpackModel, shader);
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+	if (option == "--bench-scene-nodes") {
+		modelLoader.finish();
+
+		bool passed = runSceneNodeBenchmark(*backpackModel, shader);
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+	if (option == "--bench-multidraw") {
+		modelLoader.finish();
+
+		bool passed = runMultiDrawBenchmark(window, frameUBO, *backpackModel, shader, multiDrawShader);
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+
+	// ---------------------------------------------------------------------------------------------- SCENE
+	Scene scene;
+
+	// ----------------------| Backpack
+	glm::mat4 modelMat = glm::mat4(1.0f);
+	modelMat = glm::translate(modelMat, glm::vec3(-1.0f, 0.0f, 0.0f));
+	modelMat = glm::scale(modelMat, glm::vec3(0.5f));
+
+	int backpack = scene.add(*backpackModel, shader, modelMat);
+	scene.setOccluder(backpack, true);
+
+	// ----------------------| Robot
+	modelMat = glm::mat4(1.0f);
+	modelMat = glm::translate(modelMat, glm::vec3(1.0f, 0.0f, 0.0f));
+	modelMat = glm::scale(modelMat, glm::vec3(1.0f));
+
+	scene.add(*robotModel, flipShader, modelMat, &flipAlphaShader);
+
+	RenderQueue renderQueue;
+	OcclusionCuller occlusionCuller;
+	renderQueue.setOcclusion(&occlusionCuller);
+	if (GLEXT_ARB_multi_draw_indirect) {
+		renderQueue.setMultiDrawVariant(shader, *multiDrawShader);
+		renderQueue.setMultiDrawVariant(flipShader, *multiDrawFlipShader);
+		renderQueue.setMultiDrawVariant(flipAlphaShader, *multiDrawFlipAlphaShader);
+	}
+
+	float statsTime = 0.0f;
+	int statsFrames = 0;
 
 	// ---------------------------------------------------------------------------------------------- RENDER LOOP
 	while (!glfwWindowShouldClose(window)) {
@@ -121,15 +294,36 @@ int main() {
 		currentTime = glfwGetTime();
 
 		processInput(window);
+		modelLoader.pump(LOADING_BUDGET_MS);
+		geometryBuffer().defragment(DEFRAGMENT_BUDGET_BYTES);
 
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// ------------------------------------------------------------------------------------| Projection & Transformations
-		projection = glm::perspective(glm::radians(camera.Zoom), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
+		projection = glm::perspective(glm::radians(camera.Zoom), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
 		view = camera.GetViewMatrix();
 
+		frameData.projection	= projection;
+		frameData.view			= view;
+		frameData.viewPos		= camera.Position;
+		frameData.viewProjection	= projection * view;
+		frameUBO.update(frameData);
+
 		// ------------------------------------------| Lights
+		lightsData.numPointLights = sceneLights;
+		lightsData.numSpotLights = 0;
+
+		PointLightBlock& pointLight = lightsData.pointLights[0];
+		pointLight.position		= lightPos;
+		pointLight.constant		= 1.0f;
+		pointLight.linear		= 0.09f;
+		pointLight.quadratic	= 0.032f;
+		pointLight.diffuse		= lightColor;
+		pointLight.specular		= lightColor;
+		pointLight.ambient		= lightColor * 0.2f;
+		lightsUBO.update(lightsData);
+
 		glm::mat4 lightModel = glm::mat4(1.0f);
 		float radius = 3.0;
 
@@ -137,46 +331,40 @@ int main() {
 		lightModel = glm::scale(lightModel, glm::vec3(0.2f));
 
 		lightShader.use();
-		lightShader.setMat("model", lightModel);
-		lightShader.setMat("view", view);
-		lightShader.setMat("projection", projection);
-		lightShader.setFloat("color", lightColor);
+		lightShader.set(lightMVPHandle, frameData.viewProjection * lightModel);
+		lightShader.set(lightColorHandle, lightColor);
 
-		glBindVertexArray(cubeVAO);
+		lightShader.flush();
+		glState.bindVertexArray(cubeVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
+		glState.countDraw();
 
 		// ------------------------------------------| Objects
-		// ----------------------| Backpack
-		glm::mat4 modelMat = glm::mat4(1.0f);
-		modelMat = glm::translate(modelMat, glm::vec3(-1.0f, 0.0f, 0.0f));
-		modelMat = glm::scale(modelMat, glm::vec3(0.5f));
-		
-		shader.use();
-		shader.setMat("projection",		projection);
-		shader.setMat("view",			view);
-		shader.setMat("model",			modelMat);
-		
-		shader.setBool("flipUV", false);
-
-		shader.setFloat("pointLights[0].position",	lightPos);
-		shader.setFloat("pointLights[0].constant",	1.0f);
-		shader.setFloat("pointLights[0].linear",	0.09f);
-		shader.setFloat("pointLights[0].linear",	0.032f);
-
-		shader.setFloat("pointLights[0].diffuse",	lightColor);
-		shader.setFloat("pointLights[0].specular",	lightColor);
-		shader.setFloat("pointLights[0].ambient",	lightColor * 0.2f);
-
-		backpackModel.Draw(shader);
-
-		// ----------------------| Robot
-		modelMat = glm::mat4(1.0f);
-		modelMat = glm::translate(modelMat, glm::vec3(1.0f, 0.0f, 0.0f));
-		modelMat = glm::scale(modelMat, glm::vec3(1.0f));
-
-		shader.setBool("flipUV", true);
-		shader.setMat("model", modelMat);
-		robotModel.Draw(shader);
+		renderQueue.begin(view, projection, NEAR_PLANE, FAR_PLANE);
+		occlusionCuller.begin(frameData.viewProjection);
+		scene.submit(renderQueue, &occlusionCuller);
+		renderQueue.execute();
+
+		// ------------------------------------------| Stats
+		statsFrames++;
+		if (currentTime - statsTime >= 1.0f) {
+			const StateCounters& counters = glState.getCounters();
+			const CullStats& culling = renderQueue.getStats();
+			GeometryStats geometry = geometryBuffer().getStats();
+
+			std::stringstream title;
+			title << "LearnOpenGL - " << statsFrames << " fps - per frame: " << counters.draws / statsFrames << " draws, state changes "
+				<< counters.issued / statsFrames << " issued, " << counters.filtered / statsFrames << " filtered, meshes "
+				<< culling.visible / statsFrames << " visible, " << (culling.submitted - culling.visible - culling.occluded) / statsFrames << " culled, "
+				<< culling.occluded / statsFrames << " occluded, geometry " << 100 * (geometry.vertexUsed + geometry.indexUsed) / std::max<size_t>(geometry.vertexCapacity + geometry.indexCapacity, 1)
+				<< "% used, " << (int)(geometry.fragmentation * 100.0f) << "% fragmented";
+			glfwSetWindowTitle(window, title.str().c_str());
+
+			glState.resetCounters();
+			renderQueue.resetStats();
+			statsTime = currentTime;
+			statsFrames = 0;
+		}
 
 		// ------------------------------------------| Clean Up
 		glfwSwapBuffers(window);
@@ -353,9 +541,7 @@ void setupKeyMap(GLFWwindow* window)
 	keymap[GLFW_KEY_T] = KeySettings{
 		GLFW_KEY_T,
 		[&] {
-			GLint modes[2];
-			glGetIntegerv(GL_POLYGON_MODE, modes);
-			glPolygonMode(GL_FRONT_AND_BACK, modes[0] == GL_LINE ? GL_FILL : GL_LINE);
+			glState.polygonMode(glState.getPolygonMode() == GL_LINE ? GL_FILL : GL_LINE);
 		}
 	};
 
@@ -376,7 +562,7 @@ void processInput(GLFWwindow* window) {
 unsigned int loadTexture(const char* imagePath, const bool isPng) {
 	unsigned int texture;
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	glState.bindTexture(0, GL_TEXTURE_2D, texture);
 
 	int width, height, nrChannels;
 	stbi_set_flip_vertically_on_load(true);
@@ -437,18 +623,18 @@ unsigned int generateCube()
 
 	unsigned int VAO;
 	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+	glState.bindVertexArray(VAO);
 
 	unsigned int VBO;
 	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
 	// position
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
 
-	glBindVertexArray(0);
+	glState.bindVertexArray(0);
 
 	return VAO;
 }
@@ -0,0 +1,133 @@
+#include "mappedfile.h"
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	// sharing delete lets a writer rename a new cache file over this one while it is mapped
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE view = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (view == NULL) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	bytes = static_cast<const unsigned char*>(MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+	if (bytes == NULL) {
+		CloseHandle(view);
+		CloseHandle(handle);
+		return false;
+	}
+
+	file = handle;
+	mapping = view;
+	length = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+
+	bytes = NULL;
+	mapping = NULL;
+	file = NULL;
+	length = 0;
+}
+#else
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	int descriptor = ::open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+		::close(descriptor);
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// the mapping keeps the file alive on its own
+	::close(descriptor);
+	if (view == MAP_FAILED)
+		return false;
+
+	bytes = static_cast<const unsigned char*>(view);
+	length = (size_t)status.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		munmap(const_cast<unsigned char*>(bytes), length);
+
+	bytes = NULL;
+	length = 0;
+}
+#endif
+
+// ---------------------------------------------------------------------------------------------- Replacing Files
+std::string temporaryPathFor(const std::string& path)
+{
+	static std::atomic<unsigned int> counter{ 0 };
+
+#ifdef _WIN32
+	unsigned long process = GetCurrentProcessId();
+#else
+	unsigned long process = (unsigned long)getpid();
+#endif
+	size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+	return path + "." + std::to_string(process) + "." + std::to_string(thread) + "." + std::to_string(counter++) + ".tmp";
+}
+
+bool replaceFile(const std::string& temporaryPath, const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (!error)
+		return true;
+
+	std::filesystem::remove(temporaryPath, error);
+	return false;
+}
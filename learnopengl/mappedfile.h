@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false when the file is missing, empty or cannot be mapped.
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+	bool isOpen() const { return bytes != NULL; }
+
+private:
+	const unsigned char* bytes = NULL;
+	size_t length = 0;
+
+#ifdef _WIN32
+	void* file = NULL;
+	void* mapping = NULL;
+#endif
+};
+
+// ---------------------------------------------------------------------------------------------- Replacing Files
+// Caches are written to a temporary file next to the real one and renamed over it, so a reader
+// mapping the path sees either the old file or the complete new one, never a partial write.
+
+// Unique to this process and thread, in the same directory as path.
+std::string temporaryPathFor(const std::string& path);
+// Moves temporaryPath over path. On failure the temporary file is removed and path left alone.
+bool replaceFile(const std::string& temporaryPath, const std::string& path);
+
+#endif //MAPPEDFILE_H
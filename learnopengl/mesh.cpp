@@ -1,22 +1,325 @@
 #include "mesh.h"
+#include "glstate.h"
+#include "glextensions.h"
+#include "hash.h"
+#include "vertexformat.h"
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+bool Mesh::packedVertices = true;
+
+void MeshData::computeBounds()
+{
+    if (bounds.isEmpty())
+    {
+        for (const Vertex& vertex : vertices)
+            bounds.expand(vertex.Position);
+    }
+
+    // sphere around the box centre, sized to the farthest vertex rather than the box corner
+    sphere.center = bounds.isEmpty() ? glm::vec3(0.0f) : bounds.center();
+    float radiusSquared = 0.0f;
+    for (const Vertex& vertex : vertices)
+    {
+        glm::vec3 offset = vertex.Position - sphere.center;
+        radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+    }
+    sphere.radius = glm::sqrt(radiusSquared);
+}
+
+void MeshData::optimizeIndices(VertexCacheStats& before, VertexCacheStats& after)
+{
+    before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+    optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    optimizeOverdraw(indices.data(), indices.size(), &vertices[0].Position.x, vertices.size(), sizeof(Vertex));
+    vertices.resize(optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size()));
+
+    after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+}
+
+// positions by their bits, the other attributes are compared within tolerance among equal positions
+struct WeldKey {
+    int32_t position[3];
+
+    bool operator==(const WeldKey& other) const { return memcmp(this, &other, sizeof(WeldKey)) == 0; }
+};
+
+struct WeldKeyHash {
+    size_t operator()(const WeldKey& key) const { return (size_t)hashBytes(&key, sizeof(WeldKey)); }
+};
+
+static int32_t floatBits(float value)
+{
+    // adding zero turns -0 into 0 so they compare equal
+    value += 0.0f;
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    return bits;
+}
+
+static bool withinTolerance(const Vertex& a, const Vertex& b, float normalEpsilon, float uvEpsilon)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (fabs(a.Normal[axis] - b.Normal[axis]) > normalEpsilon)
+            return false;
+    }
+    return fabs(a.TexCoords.x - b.TexCoords.x) <= uvEpsilon && fabs(a.TexCoords.y - b.TexCoords.y) <= uvEpsilon;
+}
+
+size_t MeshData::weldVertices(float normalEpsilon, float uvEpsilon)
+{
+    const unsigned int NONE = ~0u;
+    // first kept vertex at each position, the rest chained through next in the order they were kept
+    unordered_map<WeldKey, unsigned int, WeldKeyHash> first;
+    first.reserve(vertices.size());
+
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    vector<unsigned int> next;
+    welded.reserve(vertices.size());
+    next.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+
+        WeldKey key;
+        for (int axis = 0; axis < 3; axis++)
+            key.position[axis] = floatBits(vertex.Position[axis]);
+
+        // only a handful of vertices share a position, so the chain is short
+        auto found = first.emplace(key, (unsigned int)welded.size());
+        unsigned int match = NONE;
+        if (!found.second)
+        {
+            unsigned int last = NONE;
+            for (unsigned int candidate = found.first->second; candidate != NONE; candidate = next[candidate])
+            {
+                if (withinTolerance(welded[candidate], vertex, normalEpsilon, uvEpsilon))
+                {
+                    match = candidate;
+                    break;
+                }
+                last = candidate;
+            }
+            if (match == NONE)
+                next[last] = (unsigned int)welded.size();
+        }
+
+        if (match == NONE)
+        {
+            match = (unsigned int)welded.size();
+            welded.push_back(vertex);
+            next.push_back(NONE);
+        }
+        remap[i] = match;
+    }
+
+    for (unsigned int& index : indices)
+        index = remap[index];
+
+    size_t removed = vertices.size() - welded.size();
+    vertices = std::move(welded);
+    return removed;
+}
+
+vector<MeshData> MeshData::split(size_t maxVertices) const
+{
+    const unsigned int UNUSED = ~0u;
+    vector<MeshData> parts;
+    vector<unsigned int> remap(vertices.size(), UNUSED);
+    vector<unsigned int> touched;
+
+    auto finish = [&]() {
+        MeshData& part = parts.back();
+        part.computeBounds();
+        for (unsigned int vertex : touched)
+            remap[vertex] = UNUSED;
+        touched.clear();
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        unsigned int added = 0;
+        for (int k = 0; k < 3; k++)
+            added += remap[indices[i + k]] == UNUSED ? 1 : 0;
+
+        if (parts.empty() || parts.back().vertices.size() + added > maxVertices)
+        {
+            if (!parts.empty())
+                finish();
+            parts.emplace_back();
+            parts.back().materialTextures = materialTextures;
+            parts.back().transparent = transparent;
+            parts.back().node = node;
+        }
+
+        MeshData& part = parts.back();
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int vertex = indices[i + k];
+            if (remap[vertex] == UNUSED)
+            {
+                remap[vertex] = (unsigned int)part.vertices.size();
+                part.vertices.push_back(vertices[vertex]);
+                touched.push_back(vertex);
+            }
+            part.indices.push_back(remap[vertex]);
+        }
+    }
+
+    if (!parts.empty())
+        finish();
+    return parts;
+}
+
+Mesh::Mesh(MeshData data, vector<Texture> textures)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    this->vertices = std::move(data.vertices);
+    this->indices = std::move(data.indices);
+    this->textures = std::move(textures);
+    this->bounds = data.bounds;
+    this->sphere = data.sphere;
 
     setupMesh();
+    setupSamplers();
 }
 
 void Mesh::Draw(Shader& shader)
+{
+    bindMaterial(shader);
+
+    // draw mesh
+    shader.flush();
+    GeometryRange range = geometryBuffer().range(geometry);
+    glState.bindVertexArray(range.vao);
+    glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), indexType, (void*)range.indexOffset, range.baseVertex);
+    glState.countDraw();
+}
+
+void Mesh::DrawInstanced(Shader& shader, unsigned int instanceCount)
+{
+    bindMaterial(shader);
+
+    shader.flush();
+    GeometryRange range = geometryBuffer().range(geometry);
+    glState.bindVertexArray(range.vao);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indices.size(), indexType, (void*)range.indexOffset, instanceCount, range.baseVertex);
+    glState.countDraw();
+}
+
+void Mesh::DrawIndirect(Shader& shader, size_t commandOffset)
+{
+    bindMaterial(shader);
+
+    shader.flush();
+    glState.bindVertexArray(getVAO());
+    glDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)commandOffset);
+    glState.countDraw();
+}
+
+DrawElementsIndirectCommand Mesh::indirectCommand() const
+{
+    GeometryRange range = getRange();
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    return { (GLuint)indices.size(), 0, (GLuint)(range.indexOffset / indexSize), range.baseVertex, 0 };
+}
+
+void Mesh::setupInstancing(unsigned int instanceBuffer)
+{
+    geometryBuffer().bindInstances(geometry, instanceBuffer);
+}
+
+void Mesh::release()
+{
+    geometryBuffer().release(geometry);
+    geometry = NO_GEOMETRY;
+}
+
+void Mesh::bindMaterial(Shader& shader)
+{
+    if (samplerProgram != shader.ID)
+    {
+        samplerHandles.clear();
+        for (const string& name : samplerNames)
+            samplerHandles.push_back(shader.uniform<int>(name));
+        samplerProgram = shader.ID;
+    }
+
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        shader.set(samplerHandles[i], i);
+        glState.bindTexture(i, GL_TEXTURE_2D, textures[i].id);
+    }
+}
+
+unsigned int Mesh::materialKey() const
+{
+    unsigned int key = 0;
+    for (const Texture& texture : textures)
+        key = key * 31 + texture.id;
+
+    return key;
+}
+
+bool Mesh::sameMaterial(const Mesh& other) const
+{
+    if (textures.size() != other.textures.size())
+        return false;
+
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        if (textures[i].id != other.textures[i].id || samplerNames[i] != other.samplerNames[i])
+            return false;
+    }
+    return true;
+}
+
+void Mesh::setupMesh()
+{
+    // packed or float vertices and 16 or 32 bit indices, into whichever arena has room
+    vector<PackedVertex> packed;
+    const void* vertexData = vertices.data();
+    VertexLayout layout = LAYOUT_FLOAT;
+    dequantization = glm::mat4(1.0f);
+    if (packedVertices)
+    {
+        packed.resize(vertices.size());
+        packVertices(vertices.data(), vertices.size(), bounds, packed.data());
+        vertexData = packed.data();
+        layout = LAYOUT_PACKED;
+        dequantization = dequantizationMatrix(bounds);
+    }
+
+    vector<unsigned short> shortIndices;
+    const void* indexData = indices.data();
+    size_t indexBytes = indices.size() * sizeof(unsigned int);
+    indexType = GL_UNSIGNED_INT;
+    if (vertices.size() <= MAX_SHORT_INDEX_VERTICES)
+    {
+        // half the index memory and bandwidth
+        shortIndices.assign(indices.begin(), indices.end());
+        indexData = shortIndices.data();
+        indexBytes = shortIndices.size() * sizeof(unsigned short);
+        indexType = GL_UNSIGNED_SHORT;
+    }
+
+    geometry = geometryBuffer().allocate(layout, vertexData, vertices.size(), indexData, indexBytes);
+}
+
+void Mesh::setupSamplers()
 {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int roughnessNr = 1;
+    unsigned int opacityNr = 1;
     for (unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
         // retrieve texture number (the N in diffuse_textureN)
         string number;
         string name = textures[i].type;
@@ -26,41 +329,9 @@ void Mesh::Draw(Shader& shader)
             number = std::to_string(specularNr++);
         else if (name == "texture_roughness")
             number = std::to_string(roughnessNr++);
+        else if (name == "texture_opacity")
+            number = std::to_string(opacityNr++);
 
-        shader.setInt(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        samplerNames.push_back("material." + name + number);
     }
-    glActiveTexture(GL_TEXTURE0);
-
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-}
-
-void Mesh::setupMesh()
-{
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-    // vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-
-    glBindVertexArray(0);
 }
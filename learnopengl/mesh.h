@@ -5,6 +5,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "shader.h"
+#include "bounds.h"
+#include "indexoptimizer.h"
+#include "geometrybuffer.h"
 #include <string>
 #include <vector>
 using namespace std;
@@ -17,6 +20,49 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// Per-instance vertex data for instanced draws, read through attributes 3-9.
+struct InstanceData {
+    glm::mat4 Model;
+    glm::mat3 Normal;
+};
+
+// Texture a material uses, by sampler type ("texture_diffuse", ...) and path relative to the model.
+struct TextureReference {
+    string type;
+    string path;
+};
+
+// Geometry and material of one mesh on the CPU, before it has GL objects. Filled off the GL thread
+// while loading, either from the importer or from the mesh cache.
+// Meshes with at most this many vertices are drawn with 16 bit indices.
+const size_t MAX_SHORT_INDEX_VERTICES = 65536;
+// Welding tolerances for the attributes besides the position, which has to match exactly.
+const float WELD_NORMAL_EPSILON = 1e-3f;
+const float WELD_UV_EPSILON = 1e-5f;
+
+struct MeshData {
+    vector<Vertex>           vertices;
+    vector<unsigned int>     indices;
+    AABB                     bounds;
+    BoundingSphere           sphere;
+    vector<TextureReference> materialTextures;
+    bool                     transparent = false;
+    // the model's node this mesh hangs from, see Model::getNodes
+    unsigned int             node = 0;
+
+    // Fills the box from the vertices unless the importer already set it, then sizes the sphere.
+    void computeBounds();
+    // Reorders triangles for the vertex cache and overdraw, then vertices for fetch locality. Drops
+    // unused vertices. Statistics are for the FIFO the optimizer assumes, before and after.
+    void optimizeIndices(VertexCacheStats& before, VertexCacheStats& after);
+    // Merges vertices with the same position whose normals and texture coordinates are within the
+    // tolerances, keeping the first one. Returns how many were removed.
+    size_t weldVertices(float normalEpsilon = WELD_NORMAL_EPSILON, float uvEpsilon = WELD_UV_EPSILON);
+    // Cuts the triangle list, keeping its order, into parts of at most maxVertices vertices each, so
+    // every part fits 16 bit indices. Vertices come out in first use order.
+    vector<MeshData> split(size_t maxVertices = MAX_SHORT_INDEX_VERTICES) const;
+};
+
 struct Texture {
     unsigned int id;
     string type;
@@ -25,18 +71,67 @@ struct Texture {
 
 class Mesh {
 public:
+    // Upload vertices as PackedVertex, half the size of Vertex. Off only to compare with the float layout.
+    static bool packedVertices;
+
     // mesh data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
+    // object space bounds, used for culling and depth sorting
+    AABB bounds;
+    BoundingSphere sphere;
+    // drawn in the blended pass after all opaque meshes
+    bool transparent = false;
+    // the model's node this mesh hangs from, its world matrix places the mesh in the model
+    unsigned int node = 0;
+
+    // Takes the geometry with its bounds already computed.
+    Mesh(MeshData data, vector<Texture> textures);
     void Draw(Shader& shader);
+    void DrawInstanced(Shader& shader, unsigned int instanceCount);
+    // Instanced draw whose arguments are read from the bound GL_DRAW_INDIRECT_BUFFER at offset, as
+    // written by the GPU. Needs GLEXT_ARB_compute_shader.
+    void DrawIndirect(Shader& shader, size_t commandOffset);
+    // Points the instance attributes of this mesh's VAO at a buffer of InstanceData, once.
+    void setupInstancing(unsigned int instanceBuffer);
+    // Gives the geometry back to the shared buffer. Copies of a mesh share it, release only one.
+    void release();
+
+    // Sets the sampler uniforms and binds the textures, as Draw does before drawing. For callers
+    // issuing the draw themselves from getRange().
+    void bindMaterial(Shader& shader);
+
+    // Shared with every mesh in the same geometry arena.
+    unsigned int getVAO() const { return geometryBuffer().range(geometry).vao; }
+    // Current place in the geometry buffer, defragmentation may move it between frames.
+    GeometryRange getRange() const { return geometryBuffer().range(geometry); }
+    // Draws the whole mesh from its current range, instanceCount and baseInstance left for the caller.
+    DrawElementsIndirectCommand indirectCommand() const;
+    // GL_UNSIGNED_SHORT when the vertices fit, GL_UNSIGNED_INT otherwise. The CPU copy stays 32 bit.
+    GLenum getIndexType() const { return indexType; }
+    // Multiply into the model matrix before drawing, it puts packed positions back in the mesh's box.
+    // Identity for the float layout. Normal matrices come from the model matrix alone.
+    const glm::mat4& getDequantization() const { return dequantization; }
+    // Identifies the texture set, meshes with the same key can share texture binds.
+    unsigned int materialKey() const;
+    // Binds the same textures in the same units, so either mesh's bindMaterial serves both.
+    bool sameMaterial(const Mesh& other) const;
 
 private:
     //  render data
-    unsigned int VAO, VBO, EBO;
+    GeometryHandle geometry = NO_GEOMETRY;
+    GLenum indexType = GL_UNSIGNED_INT;
+    glm::mat4 dequantization = glm::mat4(1.0f);
+
+    // sampler uniform per texture ("material.texture_diffuse1", ...), built once at construction
+    vector<string> samplerNames;
+    // locations of samplerNames, resolved against samplerProgram
+    vector<UniformHandle<int>> samplerHandles;
+    unsigned int samplerProgram = 0;
 
     void setupMesh();
+    void setupSamplers();
 };
 #endif //MESH_H
\ No newline at end of file
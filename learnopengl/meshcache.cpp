@@ -0,0 +1,263 @@
+#include "meshcache.h"
+#include "hash.h"
+#include "mappedfile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+std::string MeshCache::cacheDirectory = "meshcache";
+
+static_assert(sizeof(MeshCacheHeader) == 48, "MeshCacheHeader layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheEntry) == 80, "MeshCacheEntry layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheNode) == 80, "MeshCacheNode layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheDependency) == 16, "MeshCacheDependency layout changed, bump MESH_CACHE_VERSION");
+
+static uint64_t alignTo16(uint64_t offset)
+{
+	return (offset + 15) & ~(uint64_t)15;
+}
+
+std::string MeshCache::pathFor(const std::string& sourcePath)
+{
+	return cacheDirectory + "/" + hashToHex(hashString(sourcePath)) + ".mesh";
+}
+
+uint64_t MeshCache::hashSource(const std::string& sourcePath)
+{
+	MappedFile source;
+	if (!source.open(sourcePath))
+		return 0;
+
+	return hashBytes(source.data(), source.size());
+}
+
+// ---------------------------------------------------------------------------------------------- Load
+bool MeshCache::load(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, std::vector<MeshData>& meshes, TransformHierarchy& nodes)
+{
+	if (sourceHash == 0)
+		return false;
+
+	MappedFile file;
+	if (!file.open(cachePath) || file.size() < sizeof(MeshCacheHeader))
+		return false;
+
+	const unsigned char* bytes = file.data();
+	const size_t size = file.size();
+
+	MeshCacheHeader header;
+	std::memcpy(&header, bytes, sizeof(header));
+	if (std::memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION
+		|| header.vertexSize != sizeof(Vertex) || header.sourceHash != sourceHash || header.importFlags != importFlags)
+		return false;
+
+	// every range is checked against the file size, a truncated or foreign file is just a miss
+	auto inFile = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+
+	uint64_t entriesOffset = sizeof(MeshCacheHeader);
+	uint64_t texturesOffset = entriesOffset + (uint64_t)header.meshCount * sizeof(MeshCacheEntry);
+	uint64_t nodesOffset = texturesOffset + (uint64_t)header.textureCount * sizeof(MeshCacheTexture);
+	uint64_t dependenciesOffset = nodesOffset + (uint64_t)header.nodeCount * sizeof(MeshCacheNode);
+	if (!inFile(entriesOffset, (uint64_t)header.meshCount * sizeof(MeshCacheEntry))
+		|| !inFile(texturesOffset, (uint64_t)header.textureCount * sizeof(MeshCacheTexture))
+		|| !inFile(nodesOffset, (uint64_t)header.nodeCount * sizeof(MeshCacheNode))
+		|| !inFile(dependenciesOffset, (uint64_t)header.dependencyCount * sizeof(MeshCacheDependency))
+		|| !inFile(header.stringsOffset, 0))
+		return false;
+
+	auto readString = [&](uint32_t offset, uint32_t length, std::string& value) {
+		if (!inFile(header.stringsOffset + offset, length))
+			return false;
+		value.assign(reinterpret_cast<const char*>(bytes + header.stringsOffset + offset), length);
+		return true;
+	};
+
+	// the materials and transparency come from files like the OBJ's .mtl, an edit there is a miss too
+	for (uint32_t i = 0; i < header.dependencyCount; i++) {
+		MeshCacheDependency dependency;
+		std::memcpy(&dependency, bytes + dependenciesOffset + i * sizeof(MeshCacheDependency), sizeof(dependency));
+
+		std::string path;
+		if (!readString(dependency.pathOffset, dependency.pathLength, path) || hashSource(path) != dependency.hash)
+			return false;
+	}
+
+	std::vector<MeshData> loaded(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+		MeshCacheEntry entry;
+		std::memcpy(&entry, bytes + entriesOffset + i * sizeof(MeshCacheEntry), sizeof(entry));
+
+		uint64_t vertexBytes = (uint64_t)entry.vertexCount * sizeof(Vertex);
+		uint64_t indexBytes = (uint64_t)entry.indexCount * sizeof(unsigned int);
+		if (!inFile(entry.vertexOffset, vertexBytes) || !inFile(entry.indexOffset, indexBytes)
+			|| (uint64_t)entry.firstTexture + entry.textureCount > header.textureCount || entry.node >= header.nodeCount)
+			return false;
+
+		MeshData& data = loaded[i];
+		data.vertices.resize(entry.vertexCount);
+		std::memcpy(data.vertices.data(), bytes + entry.vertexOffset, vertexBytes);
+		data.indices.resize(entry.indexCount);
+		std::memcpy(data.indices.data(), bytes + entry.indexOffset, indexBytes);
+
+		data.bounds = AABB(glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]),
+			glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]));
+		data.sphere.center = glm::vec3(entry.sphere[0], entry.sphere[1], entry.sphere[2]);
+		data.sphere.radius = entry.sphere[3];
+		data.transparent = entry.transparent != 0;
+		data.node = entry.node;
+
+		for (uint32_t t = entry.firstTexture; t < entry.firstTexture + entry.textureCount; t++) {
+			MeshCacheTexture reference;
+			std::memcpy(&reference, bytes + texturesOffset + t * sizeof(MeshCacheTexture), sizeof(reference));
+
+			TextureReference texture;
+			if (!readString(reference.typeOffset, reference.typeLength, texture.type)
+				|| !readString(reference.pathOffset, reference.pathLength, texture.path))
+				return false;
+			data.materialTextures.push_back(texture);
+		}
+	}
+
+	TransformHierarchy loadedNodes;
+	loadedNodes.reserve(header.nodeCount);
+	for (uint32_t i = 0; i < header.nodeCount; i++) {
+		MeshCacheNode node;
+		std::memcpy(&node, bytes + nodesOffset + i * sizeof(MeshCacheNode), sizeof(node));
+
+		std::string name;
+		if (node.parent >= (int32_t)i || node.parent < TransformHierarchy::ROOT || !readString(node.nameOffset, node.nameLength, name))
+			return false;
+
+		glm::mat4 local;
+		std::memcpy(&local[0][0], node.local, sizeof(node.local));
+		loadedNodes.add(node.parent, local, name);
+	}
+
+	meshes = std::move(loaded);
+	nodes = std::move(loadedNodes);
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------- Save
+bool MeshCache::save(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, const std::vector<MeshData>& meshes, const TransformHierarchy& nodes,
+	const std::vector<std::string>& dependencies)
+{
+	if (sourceHash == 0)
+		return false;
+
+	std::vector<MeshCacheEntry> entries(meshes.size());
+	std::vector<MeshCacheTexture> textures;
+	std::string strings;
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const MeshData& data = meshes[i];
+		MeshCacheEntry& entry = entries[i];
+		std::memset(&entry, 0, sizeof(entry));
+
+		entry.vertexCount = (uint32_t)data.vertices.size();
+		entry.indexCount = (uint32_t)data.indices.size();
+		entry.firstTexture = (uint32_t)textures.size();
+		entry.textureCount = (uint32_t)data.materialTextures.size();
+		for (int axis = 0; axis < 3; axis++) {
+			entry.boundsMin[axis] = data.bounds.min[axis];
+			entry.boundsMax[axis] = data.bounds.max[axis];
+			entry.sphere[axis] = data.sphere.center[axis];
+		}
+		entry.sphere[3] = data.sphere.radius;
+		entry.transparent = data.transparent ? 1 : 0;
+		entry.node = data.node;
+
+		for (const TextureReference& texture : data.materialTextures) {
+			MeshCacheTexture reference;
+			reference.typeOffset = (uint32_t)strings.size();
+			reference.typeLength = (uint32_t)texture.type.size();
+			strings += texture.type;
+			reference.pathOffset = (uint32_t)strings.size();
+			reference.pathLength = (uint32_t)texture.path.size();
+			strings += texture.path;
+			textures.push_back(reference);
+		}
+	}
+
+	std::vector<MeshCacheNode> nodeRecords(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++) {
+		MeshCacheNode& record = nodeRecords[i];
+		std::memset(&record, 0, sizeof(record));
+		record.parent = nodes.getParent((int)i);
+		record.nameOffset = (uint32_t)strings.size();
+		record.nameLength = (uint32_t)nodes.getName((int)i).size();
+		strings += nodes.getName((int)i);
+		std::memcpy(record.local, &nodes.getLocal((int)i)[0][0], sizeof(record.local));
+	}
+
+	std::vector<MeshCacheDependency> dependencyRecords(dependencies.size());
+	for (size_t i = 0; i < dependencies.size(); i++) {
+		MeshCacheDependency& record = dependencyRecords[i];
+		record.hash = hashSource(dependencies[i]);
+		record.pathOffset = (uint32_t)strings.size();
+		record.pathLength = (uint32_t)dependencies[i].size();
+		strings += dependencies[i];
+	}
+
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.importFlags = importFlags;
+	header.meshCount = (uint32_t)meshes.size();
+	header.vertexSize = sizeof(Vertex);
+	header.textureCount = (uint32_t)textures.size();
+	header.nodeCount = (uint32_t)nodeRecords.size();
+	header.dependencyCount = (uint32_t)dependencyRecords.size();
+	header.stringsOffset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry) + textures.size() * sizeof(MeshCacheTexture)
+		+ nodeRecords.size() * sizeof(MeshCacheNode) + dependencyRecords.size() * sizeof(MeshCacheDependency);
+
+	uint64_t offset = alignTo16(header.stringsOffset + strings.size());
+	for (size_t i = 0; i < meshes.size(); i++) {
+		entries[i].vertexOffset = offset;
+		offset = alignTo16(offset + meshes[i].vertices.size() * sizeof(Vertex));
+		entries[i].indexOffset = offset;
+		offset = alignTo16(offset + meshes[i].indices.size() * sizeof(unsigned int));
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+
+	// readers may have the old file mapped, it is replaced whole once the new one is written
+	std::string temporaryPath = temporaryPathFor(cachePath);
+	std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "ERROR - MESHCACHE: COULD NOT WRITE " << cachePath << std::endl;
+		return false;
+	}
+
+	const char zeros[16] = {};
+	auto padTo = [&](uint64_t target) {
+		uint64_t position = (uint64_t)file.tellp();
+		file.write(zeros, (std::streamsize)(target - position));
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MeshCacheEntry));
+	file.write(reinterpret_cast<const char*>(textures.data()), textures.size() * sizeof(MeshCacheTexture));
+	file.write(reinterpret_cast<const char*>(nodeRecords.data()), nodeRecords.size() * sizeof(MeshCacheNode));
+	file.write(reinterpret_cast<const char*>(dependencyRecords.data()), dependencyRecords.size() * sizeof(MeshCacheDependency));
+	file.write(strings.data(), strings.size());
+	for (size_t i = 0; i < meshes.size(); i++) {
+		padTo(entries[i].vertexOffset);
+		file.write(reinterpret_cast<const char*>(meshes[i].vertices.data()), meshes[i].vertices.size() * sizeof(Vertex));
+		padTo(entries[i].indexOffset);
+		file.write(reinterpret_cast<const char*>(meshes[i].indices.data()), meshes[i].indices.size() * sizeof(unsigned int));
+	}
+
+	file.close();
+	if (!file) {
+		std::error_code removeError;
+		std::filesystem::remove(temporaryPath, removeError);
+		std::cout << "ERROR - MESHCACHE: COULD NOT WRITE " << cachePath << std::endl;
+		return false;
+	}
+	return replaceFile(temporaryPath, cachePath);
+}
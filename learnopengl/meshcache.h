@@ -0,0 +1,88 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "mesh.h"
+#include "transformhierarchy.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------------------------------------------- File Layout
+// header | entry per mesh | texture references | nodes | dependencies | string bytes | vertex and index blobs (16 byte aligned)
+// Offsets are from the start of the file. Vertices are stored exactly as the Vertex struct, so loading
+// is a bounds check and a copy per blob. Bump the version whenever Vertex, this layout or the
+// processing the import does (index optimization since version 2, welding and
+// splitting for 16 bit indices since 3, the node tree since 4, dependencies since 5) changes.
+const uint32_t MESH_CACHE_VERSION = 5;
+const char MESH_CACHE_MAGIC[4] = { 'L', 'M', 'S', 'H' };
+
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t importFlags;
+	uint32_t meshCount;
+	uint32_t vertexSize;
+	uint32_t textureCount;
+	uint64_t stringsOffset;
+	uint32_t nodeCount;
+	uint32_t dependencyCount;
+};
+
+struct MeshCacheEntry {
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t firstTexture;
+	uint32_t textureCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	float sphere[4];
+	uint32_t transparent;
+	uint32_t node;
+};
+
+// offsets into the string bytes
+struct MeshCacheTexture {
+	uint32_t typeOffset;
+	uint32_t typeLength;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+};
+
+// parents come before their children, as in TransformHierarchy
+struct MeshCacheNode {
+	int32_t parent;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t padding;
+	float local[16];
+};
+
+// Another file the import read, like an OBJ's material library, with its content hash when it was read.
+struct MeshCacheDependency {
+	uint64_t hash;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+};
+
+// ---------------------------------------------------------------------------------------------- Cache
+// Cooked meshes of imported models, one file per source path. A file is only used when the source
+// content hash, the import flags and the content of every dependency it was written with still match.
+class MeshCache {
+public:
+	static std::string cacheDirectory;
+
+	static std::string pathFor(const std::string& sourcePath);
+	// Hash of the source file's bytes, 0 when it cannot be read.
+	static uint64_t hashSource(const std::string& sourcePath);
+
+	static bool load(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, std::vector<MeshData>& meshes, TransformHierarchy& nodes);
+	// dependencies are the other files the import opened, hashed as they are now.
+	static bool save(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, const std::vector<MeshData>& meshes, const TransformHierarchy& nodes,
+		const std::vector<std::string>& dependencies);
+};
+
+#endif //MESHCACHE_H
@@ -1,160 +1,482 @@
 #include "model.h"
+#include "glstate.h"
+#include "threadpool.h"
+#include "meshcache.h"
+
+#include <assimp/DefaultIOSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
 
 std::map<std::string, Texture> Model::textures_loaded;
+bool Model::parallelTextures = true;
+// textures_loaded is only written on the GL thread, workers take this to read it
+static mutex texturesMutex;
+
+// texture types a material can use, in the order they are bound
+static const struct {
+	aiTextureType type;
+	const char* name;
+} MATERIAL_TEXTURES[] = {
+	{ aiTextureType_DIFFUSE,	"texture_diffuse" },
+	{ aiTextureType_SPECULAR,	"texture_specular" },
+	{ aiTextureType_HEIGHT,		"texture_normals" },
+	{ aiTextureType_AMBIENT,	"texture_height" },
+	{ aiTextureType_OPACITY,	"texture_opacity" }
+};
+
+Model::~Model() {
+	for (Mesh& mesh : meshes)
+		mesh.release();
+}
 
-void Model::Draw(Shader& shader) {
+void Model::Draw(Shader& shader, const glm::mat4& model, const glm::mat4& viewProjection) {
+	drawModels.resize(meshes.size());
+	drawLocals.resize(meshes.size());
+	drawMatrices.resize(meshes.size());
 	for (unsigned int i = 0; i < meshes.size(); i++) {
+		drawModels[i] = model * meshTransform(meshes[i]);
+		drawLocals[i] = meshes[i].getDequantization();
+	}
+	computeDrawMatrices(viewProjection, drawModels.data(), drawLocals.data(), meshes.size(), drawMatrices.data());
+
+	const DrawUniforms& uniforms = uniformsFor(shader);
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		shader.set(uniforms.model, drawMatrices[i].model);
+		shader.set(uniforms.normalMatrix, glm::mat3(drawMatrices[i].normalMatrix));
+		shader.set(uniforms.modelViewProjection, drawMatrices[i].modelViewProjection);
 		meshes[i].Draw(shader);
 	}
 }
 
+void Model::Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model, Shader* transparentShader) {
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		Shader& meshShader = (meshes[i].transparent && transparentShader) ? *transparentShader : shader;
+		queue.submit(meshes[i], meshShader, model * meshTransform(meshes[i]));
+	}
+}
+
+void Model::AddOccluders(OcclusionCuller& occlusion, const glm::mat4& model) const {
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		if (!meshes[i].transparent)
+			occlusion.addOccluder(meshes[i], model * meshTransform(meshes[i]));
+	}
+}
+
+void Model::DrawInstanced(Shader& shader, const glm::mat4* models, size_t count) {
+	if (count == 0)
+		return;
+
+	instances.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		instances[i].Model = models[i];
+		instances[i].Normal = normalMatrix(models[i]);
+	}
+
+	if (instanceVBO == 0)
+		glGenBuffers(1, &instanceVBO);
+
+	glState.bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	if (count > instanceCapacity)
+		instanceCapacity = count;
+	// re-specifying the store every frame orphans the previous one instead of waiting for the GPU to finish reading it
+	glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances.data());
+
+	const DrawUniforms& uniforms = uniformsFor(shader);
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		shader.set(uniforms.meshModel, meshTransform(meshes[i]) * meshes[i].getDequantization());
+		shader.set(uniforms.meshNormalMatrix, normalMatrix(meshTransform(meshes[i])));
+		meshes[i].setupInstancing(instanceVBO);
+		meshes[i].DrawInstanced(shader, (unsigned int)count);
+	}
+}
+
+void Model::DrawInstanced(Shader& shader, const vector<glm::mat4>& models) {
+	DrawInstanced(shader, models.data(), models.size());
+}
+
+void Model::DrawIndirect(Shader& shader, unsigned int instanceBuffer) {
+	const DrawUniforms& uniforms = uniformsFor(shader);
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		shader.set(uniforms.meshModel, meshTransform(meshes[i]) * meshes[i].getDequantization());
+		shader.set(uniforms.meshNormalMatrix, normalMatrix(meshTransform(meshes[i])));
+		meshes[i].setupInstancing(instanceBuffer);
+		meshes[i].DrawIndirect(shader, i * sizeof(DrawElementsIndirectCommand));
+	}
+}
+
+vector<DrawElementsIndirectCommand> Model::indirectCommands() const {
+	vector<DrawElementsIndirectCommand> commands;
+	commands.reserve(meshes.size());
+	for (const Mesh& mesh : meshes)
+		commands.push_back(mesh.indirectCommand());
+
+	return commands;
+}
+
 void Model::loadModel(string path) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	directory = path.substr(0, path.find_last_of('/'));
+
+	vector<MeshData> loaded;
+	TransformHierarchy loadedNodes;
+	vector<PendingTexture> pending;
+	bool cacheHit = false;
+	if (!readMeshes(path, loaded, loadedNodes, pending, cacheHit)) {
+		state = MODEL_FAILED;
+		return;
+	}
+	setNodes(std::move(loadedNodes));
+	chrono::steady_clock::time_point geometryEnd = chrono::steady_clock::now();
+
+	uploadTextures(pending);
+	chrono::steady_clock::time_point texturesEnd = chrono::steady_clock::now();
+
+	meshes.reserve(loaded.size());
+	for (MeshData& data : loaded)
+		addMesh(std::move(data));
+	state = MODEL_READY;
+
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	cout << "MODEL: " << path << " - " << meshes.size() << " meshes, " << pending.size() << " textures in "
+		<< chrono::duration<double, milli>(end - start).count() << " ms (" << (cacheHit ? "mesh cache " : "import ")
+		<< chrono::duration<double, milli>(geometryEnd - start).count()
+		<< " ms, textures " << chrono::duration<double, milli>(texturesEnd - geometryEnd).count()
+		<< " ms, buffers " << chrono::duration<double, milli>(end - texturesEnd).count() << " ms)" << endl;
+}
+
+bool Model::readMeshes(const string& path, vector<MeshData>& loaded, TransformHierarchy& nodes, vector<PendingTexture>& pending, bool& cacheHit) {
+	string cachePath = MeshCache::pathFor(path);
+	uint64_t sourceHash = MeshCache::hashSource(path);
+
+	cacheHit = MeshCache::load(cachePath, sourceHash, MODEL_IMPORT_FLAGS, loaded, nodes);
+	if (cacheHit) {
+		pending = decodeTextures(path.substr(0, path.find_last_of('/')), loaded);
+		return true;
+	}
+
+	vector<string> dependencies;
+	if (!importMeshes(path, loaded, &pending, &nodes, &dependencies))
+		return false;
+	MeshCache::save(cachePath, sourceHash, MODEL_IMPORT_FLAGS, loaded, nodes, dependencies);
+	return true;
+}
+
+void Model::addMesh(MeshData data) {
+	meshes.push_back(createMesh(std::move(data)));
+	bounds.expand(meshes.back().bounds.transformed(meshTransform(meshes.back())));
+	revision++;
+}
+
+void Model::setNodes(TransformHierarchy loadedNodes) {
+	nodes = std::move(loadedNodes);
+	nodes.update();
+}
+
+const glm::mat4& Model::meshTransform(const Mesh& mesh) const {
+	static const glm::mat4 identity(1.0f);
+	return mesh.node < nodes.size() ? nodes.getWorld(mesh.node) : identity;
+}
+
+const Model::DrawUniforms& Model::uniformsFor(Shader& shader) {
+	// a model is drawn with one or two shaders, so a scan beats looking up five names per draw
+	for (const DrawUniforms& uniforms : drawUniforms) {
+		if (uniforms.shader == &shader)
+			return uniforms;
+	}
+
+	drawUniforms.push_back({ &shader, shader.uniform<glm::mat4>("model"), shader.uniform<glm::mat3>("normalMatrix"),
+		shader.uniform<glm::mat4>("modelViewProjection"), shader.uniform<glm::mat4>("meshModel"),
+		shader.uniform<glm::mat3>("meshNormalMatrix") });
+	return drawUniforms.back();
+}
+
+void Model::setNodeTransform(int node, const glm::mat4& local) {
+	nodes.setLocal(node, local);
+}
+
+void Model::updateNodes() {
+	if (nodes.update() == 0)
+		return;
+
+	bounds = AABB();
+	for (const Mesh& mesh : meshes)
+		bounds.expand(mesh.bounds.transformed(meshTransform(mesh)));
+	revision++;
+}
+
+// Assimp's own file access, keeping the names of the files it opened besides the model itself.
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+	RecordingIOSystem(const string& path, vector<string>& opened) : path(path), opened(opened) {}
+
+	Assimp::IOStream* Open(const char* file, const char* mode) override {
+		Assimp::IOStream* stream = DefaultIOSystem::Open(file, mode);
+		if (stream && file != path && std::find(opened.begin(), opened.end(), file) == opened.end())
+			opened.push_back(file);
+		return stream;
+	}
+
+private:
+	string path;
+	vector<string>& opened;
+};
+
+bool Model::importMeshes(const string& path, vector<MeshData>& loaded, vector<PendingTexture>* pending, TransformHierarchy* nodes, vector<string>* dependencies) {
 	Assimp::Importer import;
-	const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	// the importer owns the handler and deletes it with itself
+	if (dependencies) {
+		dependencies->clear();
+		import.SetIOHandler(new RecordingIOSystem(path, *dependencies));
+	}
+	const aiScene* scene = import.ReadFile(path, MODEL_IMPORT_FLAGS);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		cout << "ERROR - ASSIMP: " << import.GetErrorString() << endl;
-		return;
+		return false;
 	}
 
-	directory = path.substr(0, path.find_last_of('/'));
+	vector<aiMesh*> sceneMeshes;
+	vector<unsigned int> meshNodes;
+	TransformHierarchy sceneNodes;
+	processNode(scene->mRootNode, TransformHierarchy::ROOT, scene, sceneMeshes, meshNodes, sceneNodes);
+	if (nodes)
+		*nodes = std::move(sceneNodes);
+
+	loaded.clear();
+	loaded.resize(sceneMeshes.size());
+	for (size_t i = 0; i < sceneMeshes.size(); i++) {
+		readMaterial(sceneMeshes[i], scene, loaded[i]);
+		loaded[i].node = meshNodes[i];
+	}
 
-	processNode(scene->mRootNode, scene);
+	// textures start decoding on the worker pool now, before the vertex data is converted there too
+	if (pending)
+		*pending = decodeTextures(path.substr(0, path.find_last_of('/')), loaded);
+
+	vector<size_t> importedVertices(sceneMeshes.size());
+	vector<VertexCacheStats> before(sceneMeshes.size());
+	vector<VertexCacheStats> after(sceneMeshes.size());
+	workerPool().parallelFor(sceneMeshes.size(), [&](size_t i) {
+		convertMesh(sceneMeshes[i], loaded[i]);
+		importedVertices[i] = loaded[i].vertices.size();
+		loaded[i].weldVertices();
+		if (!loaded[i].indices.empty())
+			loaded[i].optimizeIndices(before[i], after[i]);
+	});
+
+	// reported here rather than from the workers so the lines do not interleave
+	size_t vertexCountBefore = 0;
+	size_t vertexCountAfter = 0;
+	size_t indexBytesBefore = 0;
+	size_t indexBytesAfter = 0;
+	size_t splitCount = 0;
+	vector<MeshData> meshes;
+	meshes.reserve(loaded.size());
+	for (size_t i = 0; i < loaded.size(); i++) {
+		cout << "MESH: " << path << " #" << i << " - " << loaded[i].indices.size() / 3 << " triangles, vertices "
+			<< importedVertices[i] << " -> " << loaded[i].vertices.size() << ", ACMR " << before[i].acmr << " -> " << after[i].acmr
+			<< ", ATVR " << before[i].atvr << " -> " << after[i].atvr << endl;
+
+		vertexCountBefore += importedVertices[i];
+		indexBytesBefore += loaded[i].indices.size() * sizeof(unsigned int);
+
+		// too many vertices for 16 bit indices, cut in parts that each fit
+		if (loaded[i].vertices.size() > MAX_SHORT_INDEX_VERTICES) {
+			vector<MeshData> parts = loaded[i].split();
+			splitCount++;
+			for (MeshData& part : parts)
+				meshes.push_back(std::move(part));
+		}
+		else {
+			meshes.push_back(std::move(loaded[i]));
+		}
+	}
+	loaded = std::move(meshes);
+
+	for (const MeshData& data : loaded) {
+		vertexCountAfter += data.vertices.size();
+		indexBytesAfter += data.indices.size() * (data.vertices.size() <= MAX_SHORT_INDEX_VERTICES ? sizeof(unsigned short) : sizeof(unsigned int));
+	}
+	cout << "WELD: " << path << " - vertices " << vertexCountBefore << " -> " << vertexCountAfter << ", index buffers "
+		<< indexBytesBefore / 1024.0 << " KB -> " << indexBytesAfter / 1024.0 << " KB, " << splitCount << " meshes split" << endl;
+
+	return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+void Model::processNode(aiNode* node, int parent, const aiScene* scene, vector<aiMesh*>& found, vector<unsigned int>& foundNodes, TransformHierarchy& nodes) {
+	// Assimp matrices are row major
+	glm::mat4 local = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+	int index = nodes.add(parent, local, node->mName.C_Str());
+
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		found.push_back(scene->mMeshes[node->mMeshes[i]]);
+		foundNodes.push_back((unsigned int)index);
 	}
 
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], index, scene, found, foundNodes, nodes);
 	}
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-	vector<Vertex> vertices;
-	vector<unsigned int> indices;
-	vector<Texture> textures;
+void Model::readMaterial(const aiMesh* mesh, const aiScene* scene, MeshData& data) {
+	if (mesh->mMaterialIndex >= scene->mNumMaterials)
+		return;
 
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-		Vertex vertex {};
-
-		glm::vec3 vector {};
-		vector.x = mesh->mVertices[i].x;
-		vector.y = mesh->mVertices[i].y;
-		vector.z = mesh->mVertices[i].z;
-		vertex.Position = vector;
-
-		vector.x = mesh->mNormals[i].x;
-		vector.y = mesh->mNormals[i].y;
-		vector.z = mesh->mNormals[i].z;
-		vertex.Normal = vector;
-
-		if (mesh->mTextureCoords[0]) {
-			glm::vec2 vec {};
-			vec.x = mesh->mTextureCoords[0][i].x;
-			vec.y = mesh->mTextureCoords[0][i].y;
-			vertex.TexCoords = vec;
-		} else {
-			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+	bool opacityMap = false;
+	for (const auto& textureType : MATERIAL_TEXTURES) {
+		for (unsigned int i = 0; i < material->GetTextureCount(textureType.type); i++) {
+			aiString str;
+			material->GetTexture(textureType.type, i, &str);
+			data.materialTextures.push_back({ textureType.name, str.C_Str() });
+			opacityMap = opacityMap || textureType.type == aiTextureType_OPACITY;
 		}
-
-		vertices.push_back(vertex);
 	}
 
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++) {
-			indices.push_back(face.mIndices[j]);
-		}
-	}
+	float opacity = 1.0f;
+	material->Get(AI_MATKEY_OPACITY, opacity);
+	data.transparent = opacityMap || opacity < 1.0f;
+}
 
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+void Model::convertMesh(const aiMesh* mesh, MeshData& data) {
+	// one flat loop per attribute over pre-sized storage, with the per-mesh checks hoisted out
+	data.vertices.resize(mesh->mNumVertices);
+	Vertex* vertices = data.vertices.data();
+	const unsigned int count = mesh->mNumVertices;
+
+	const aiVector3D* positions = mesh->mVertices;
+	for (unsigned int i = 0; i < count; i++)
+		vertices[i].Position = glm::vec3(positions[i].x, positions[i].y, positions[i].z);
+
+	const aiVector3D* normals = mesh->mNormals;
+	if (normals) {
+		for (unsigned int i = 0; i < count; i++)
+			vertices[i].Normal = glm::vec3(normals[i].x, normals[i].y, normals[i].z);
+	} else {
+		for (unsigned int i = 0; i < count; i++)
+			vertices[i].Normal = glm::vec3(0.0f);
+	}
 
-		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+	const aiVector3D* texCoords = mesh->mTextureCoords[0];
+	if (texCoords) {
+		for (unsigned int i = 0; i < count; i++)
+			vertices[i].TexCoords = glm::vec2(texCoords[i].x, texCoords[i].y);
+	} else {
+		for (unsigned int i = 0; i < count; i++)
+			vertices[i].TexCoords = glm::vec2(0.0f);
+	}
 
-		vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normals");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+	size_t indexCount = 0;
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+		indexCount += mesh->mFaces[i].mNumIndices;
 
-		vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+	data.indices.resize(indexCount);
+	unsigned int* indices = data.indices.data();
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+		const aiFace& face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+			*indices++ = face.mIndices[j];
 	}
 
-	return Mesh(vertices, indices, textures);
+	// filled in by aiProcess_GenBoundingBoxes
+	data.bounds = AABB(
+		glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z),
+		glm::vec3(mesh->mAABB.mMax.x, mesh->mAABB.mMax.y, mesh->mAABB.mMax.z));
+	data.computeBounds();
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) const {
+Mesh Model::createMesh(MeshData data) {
 	vector<Texture> textures;
+	{
+		// a texture that failed to load stays unbound rather than adding an entry workers may be reading
+		lock_guard<mutex> lock(texturesMutex);
+		for (const TextureReference& reference : data.materialTextures) {
+			map<string, Texture>::const_iterator found = Model::textures_loaded.find(reference.path);
+			Texture texture = found != Model::textures_loaded.end() ? found->second : Texture();
+			texture.type = reference.type;
+			textures.push_back(texture);
+		}
+	}
 
-	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-		aiString str;
-		mat->GetTexture(type, i, &str);
+	bool transparent = data.transparent;
+	unsigned int node = data.node;
+	Mesh result(std::move(data), textures);
+	result.transparent = transparent;
+	result.node = node;
 
-		if (Model::textures_loaded.count(str.C_Str()) > 0) {
-			textures.push_back(Model::textures_loaded[str.C_Str()]);
-			continue;
-		}
+	return result;
+}
 
-		Texture texture;
-		texture.id = TextureFromFile(str.C_Str(), directory);
-		texture.type = typeName;
-		texture.path = str.C_Str();
-		Model::textures_loaded[str.C_Str()] = texture;
-		textures.push_back(texture);
+vector<Model::PendingTexture> Model::decodeTextures(const string& directory, const vector<MeshData>& loaded) {
+	vector<PendingTexture> pending;
+	set<string> requested;
+
+	// runs on the worker pool for async loads while the GL thread adds textures
+	lock_guard<mutex> lock(texturesMutex);
+	for (const MeshData& data : loaded) {
+		for (const TextureReference& reference : data.materialTextures) {
+			if (Model::textures_loaded.count(reference.path) > 0 || !requested.insert(reference.path).second)
+				continue;
+
+			PendingTexture texture;
+			texture.path = reference.path;
+			texture.type = reference.type;
+
+			string filename = directory + '/' + reference.path;
+			// block compression would wreck the precision normal maps need
+			bool compressible = reference.type != "texture_normals";
+			if (parallelTextures) {
+				texture.image = workerPool().submit([filename, compressible] { return decodeTexture(filename, compressible); });
+			} else {
+				promise<TextureImage> decoded;
+				decoded.set_value(decodeTexture(filename, compressible));
+				texture.image = decoded.get_future();
+			}
+			pending.push_back(std::move(texture));
+		}
 	}
-	
-	return textures;
+
+	return pending;
 }
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
-{
-	string filename = string(path);
-	filename = directory + '/' + filename;
+void Model::uploadTextures(vector<PendingTexture>& pending) {
+	for (PendingTexture& texture : pending)
+		uploadPendingTexture(texture);
+}
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+void Model::uploadPendingTexture(PendingTexture& texture) {
+	TextureImage image = texture.image.get();
+	// another model may have loaded the same file while this one was decoding
+	if (Model::textures_loaded.count(texture.path) > 0)
+		return;
 
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3) {
-			format = GL_RGB;
-			glEnable(GL_FRAMEBUFFER_SRGB);
-		}
-		else if (nrComponents == 4)
-			format = GL_RGBA;
+	size_t bytes = image.byteSize();
+	bool cacheHit = image.cacheHit;
+	double decode = image.decodeMilliseconds;
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	chrono::steady_clock::time_point uploadStart = chrono::steady_clock::now();
+	Texture loaded;
+	loaded.id = uploadTexture(image, texture.path.c_str());
+	double upload = chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count();
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	double megabytes = bytes / (1024.0 * 1024.0);
+	cout << "TEXTURE: " << texture.path << " - " << (cacheHit ? "cooked cache hit" : "cooked") << ", " << megabytes << " MB, "
+		<< (cacheHit ? "map " : "decode ") << decode << " ms, upload " << upload << " ms, " << megabytes / ((decode + upload) / 1000.0) << " MB/s" << endl;
 
-		if (nrComponents == 3) {
-			glDisable(GL_FRAMEBUFFER_SRGB);
-		}
+	loaded.type = texture.type;
+	loaded.path = texture.path;
 
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
+	lock_guard<mutex> lock(texturesMutex);
+	Model::textures_loaded[texture.path] = loaded;
+}
 
-	return textureID;
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+{
+	TextureImage image = decodeTexture(directory + '/' + string(path));
+	return uploadTexture(image, path);
 }
@@ -12,6 +12,10 @@
 
 #include "mesh.h"
 #include "shader.h"
+#include "renderqueue.h"
+#include "occlusion.h"
+#include "texturecache.h"
+#include "transformhierarchy.h"
 
 #include <string>
 #include <fstream>
@@ -19,31 +23,149 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <future>
 
 using namespace std;
 
+// Post-processing every model goes through. Part of the mesh cache key.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenBoundingBoxes;
+
+enum ModelState {
+    MODEL_LOADING,
+    MODEL_READY,
+    MODEL_FAILED,
+    MODEL_CANCELLED
+};
+
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
 class Model {
 public:
     static map<string, Texture> textures_loaded;
+    // Decode a model's textures concurrently on the worker pool. Off only to measure the serial path.
+    static bool parallelTextures;
+
+    // A texture being decoded on the worker pool, uploaded once the future is ready.
+    struct PendingTexture {
+        string path;
+        string type;
+        future<TextureImage> image;
+    };
 
+    // Reads the file through Assimp into CPU-side meshes with optimized index order, skipping the
+    // mesh cache. When pending is
+    // given, the textures start decoding as soon as the materials are read. When nodes is given it
+    // receives the node tree the meshes' node indices point into. When dependencies is given it
+    // receives every other file Assimp opened, like an OBJ's material libraries.
+    static bool importMeshes(const string& path, vector<MeshData>& loaded, vector<PendingTexture>* pending = NULL, TransformHierarchy* nodes = NULL,
+        vector<string>* dependencies = NULL);
+
+    // Blocks until the whole model is on the GPU. ModelLoader loads without stalling the frame.
     Model(const char* path)
     {
         loadModel(path);
     }
+    // Gives the meshes' geometry back to the shared buffer.
+    ~Model();
+
+    // the meshes share their geometry with copies
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Draws right away, setting the model, normalMatrix and modelViewProjection uniforms for each mesh.
+    void Draw(Shader& shader, const glm::mat4& model, const glm::mat4& viewProjection);
+    // Queues every mesh instead of drawing it. Transparent meshes use transparentShader when given.
+    void Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model, Shader* transparentShader = NULL);
+    // One instanced draw per mesh covering every matrix. Needs a shader built with INSTANCED.
+    void DrawInstanced(Shader& shader, const glm::mat4* models, size_t count);
+    void DrawInstanced(Shader& shader, const vector<glm::mat4>& models);
+    // Like DrawInstanced with InstanceData the GPU wrote into instanceBuffer: mesh i reads its draw
+    // from command i of the bound GL_DRAW_INDIRECT_BUFFER. Needs GLEXT_ARB_compute_shader.
+    void DrawIndirect(Shader& shader, unsigned int instanceBuffer);
+    // The commands DrawIndirect reads, one per mesh with no instances yet.
+    vector<DrawElementsIndirectCommand> indirectCommands() const;
+
+    // Draws the opaque meshes into the occlusion buffer.
+    void AddOccluders(OcclusionCuller& occlusion, const glm::mat4& model) const;
 
-    void Draw(Shader& shader);
+    // Object space box around every mesh, placed by its node.
+    const AABB& getBounds() const { return bounds; }
+
+    // The file's node tree, every mesh hangs from one of its nodes. It belongs to the model, so
+    // moving a node moves it in every object drawing this model.
+    const TransformHierarchy& getNodes() const { return nodes; }
+    int findNode(const string& name) const { return nodes.find(name); }
+    // Replaces a node's transform relative to its parent, applied by the next updateNodes().
+    void setNodeTransform(int node, const glm::mat4& local);
+    // Recomputes the world matrices under moved nodes, and the bounds when any moved. Once per
+    // frame after moving nodes, before the model is culled or drawn; Scene::submit does it for the
+    // models in the scene.
+    void updateNodes();
+
+    // Models from ModelLoader stay MODEL_LOADING while their meshes are added one by one, they can
+    // be drawn meanwhile with whatever is already there.
+    ModelState getState() const { return state; }
+    bool isReady() const { return state == MODEL_READY; }
+    // Bumped every time meshes are added or nodes move, so the scene knows when the bounds moved.
+    unsigned int getRevision() const { return revision; }
+    size_t meshCount() const { return meshes.size(); }
 
 private:
+    friend class ModelLoader;
+
     // model data
     vector<Mesh> meshes;
     string directory;
+    AABB bounds;
+    TransformHierarchy nodes;
+    ModelState state = MODEL_LOADING;
+    unsigned int revision = 0;
+
+    // per-mesh matrices for Draw
+    vector<glm::mat4> drawModels;
+    vector<glm::mat4> drawLocals;
+    vector<DrawMatrices> drawMatrices;
+
+    // uniforms the draws set, resolved once per shader like RenderQueue's programs
+    struct DrawUniforms {
+        Shader* shader;
+        UniformHandle<glm::mat4> model;
+        UniformHandle<glm::mat3> normalMatrix;
+        UniformHandle<glm::mat4> modelViewProjection;
+        UniformHandle<glm::mat4> meshModel;
+        UniformHandle<glm::mat3> meshNormalMatrix;
+    };
+    vector<DrawUniforms> drawUniforms;
+
+    // per-instance model and normal matrices shared by every mesh
+    unsigned int instanceVBO = 0;
+    size_t instanceCapacity = 0;
+    vector<InstanceData> instances;
+
+    // empty and loading, filled in by ModelLoader
+    Model() {}
 
     void loadModel(string path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) const;
+    // Worker side of a load: the meshes from the mesh cache or Assimp, with their textures decoding.
+    static bool readMeshes(const string& path, vector<MeshData>& loaded, TransformHierarchy& nodes, vector<PendingTexture>& pending, bool& cacheHit);
+    // Takes the node tree before any mesh is added.
+    void setNodes(TransformHierarchy loadedNodes);
+    // Where a mesh sits in the model.
+    const glm::mat4& meshTransform(const Mesh& mesh) const;
+    const DrawUniforms& uniformsFor(Shader& shader);
+    // Starts decoding every texture the meshes use that is not loaded yet.
+    static vector<PendingTexture> decodeTextures(const string& directory, const vector<MeshData>& loaded);
+    static void uploadTextures(vector<PendingTexture>& pending);
+    // Waits for the decode if needed. Skipped when another model uploaded the same file meanwhile.
+    static void uploadPendingTexture(PendingTexture& texture);
+    // Adds a converted mesh once its textures are uploaded.
+    void addMesh(MeshData data);
+    // Walks the tree parents first, adding every node and the meshes it references with its index.
+    static void processNode(aiNode* node, int parent, const aiScene* scene, vector<aiMesh*>& found, vector<unsigned int>& foundNodes, TransformHierarchy& nodes);
+    static void readMaterial(const aiMesh* mesh, const aiScene* scene, MeshData& data);
+    // Only reads the aiMesh, so it runs on the worker pool.
+    static void convertMesh(const aiMesh* mesh, MeshData& data);
+    static Mesh createMesh(MeshData data);
 };
 
 #endif //MODEL_H
\ No newline at end of file
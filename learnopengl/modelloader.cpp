@@ -0,0 +1,265 @@
+#include "modelloader.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+template<typename T>
+static bool isReady(const std::future<T>& future)
+{
+	return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ModelLoader::ModelLoader(size_t maxImports)
+	: maxImports(std::max<size_t>(maxImports, 1))
+{
+}
+
+ModelLoader::~ModelLoader()
+{
+	for (std::shared_ptr<Request>& request : requests) {
+		Read& read = *request->read;
+		read.cancelled = true;
+		if (read.started && !read.done)
+			read.reading.wait();
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- Requests
+std::shared_ptr<Model> ModelLoader::load(const std::string& path, int priority)
+{
+	std::shared_ptr<Request> request = std::make_shared<Request>();
+	request->model = std::shared_ptr<Model>(new Model());
+	request->model->directory = path.substr(0, path.find_last_of('/'));
+	for (const std::shared_ptr<Request>& other : requests) {
+		const std::shared_ptr<Read>& read = other->read;
+		if (read->path == path && read->users > 0 && !read->handedOut) {
+			request->read = read;
+			break;
+		}
+	}
+	if (!request->read) {
+		request->read = std::make_shared<Read>();
+		request->read->path = path;
+	}
+	request->read->users++;
+	request->priority = priority;
+	request->order = nextOrder++;
+	request->start = std::chrono::steady_clock::now();
+	requests.push_back(request);
+
+	// the workers can start on it before the next pump
+	startReads();
+
+	return request->model;
+}
+
+ModelLoader::Request* ModelLoader::find(const Model& model)
+{
+	for (std::shared_ptr<Request>& request : requests) {
+		if (request->model.get() == &model)
+			return request.get();
+	}
+	return NULL;
+}
+
+void ModelLoader::setPriority(const Model& model, int priority)
+{
+	if (Request* request = find(model))
+		request->priority = priority;
+}
+
+void ModelLoader::cancel(const Model& model)
+{
+	Request* request = find(model);
+	// a read in flight stops at its next check once no other load shares it, pump drops the request
+	if (request && request->model->state == MODEL_LOADING)
+		complete(*request, MODEL_CANCELLED);
+}
+
+void ModelLoader::sortRequests()
+{
+	std::sort(requests.begin(), requests.end(), [](const std::shared_ptr<Request>& a, const std::shared_ptr<Request>& b) {
+		if (a->priority != b->priority)
+			return a->priority > b->priority;
+		return a->order < b->order;
+	});
+}
+
+void ModelLoader::startReads()
+{
+	sortRequests();
+
+	// shared reads show up once per request, they count once
+	std::vector<const Read*> reading;
+	for (const std::shared_ptr<Request>& request : requests) {
+		const Read* read = request->read.get();
+		if (read->started && !read->done && std::find(reading.begin(), reading.end(), read) == reading.end())
+			reading.push_back(read);
+	}
+
+	for (const std::shared_ptr<Request>& request : requests) {
+		if (reading.size() >= maxImports)
+			break;
+		// the read goes at the priority of its most urgent request, the first one to get here
+		Read& read = *request->read;
+		if (read.started || read.cancelled)
+			continue;
+
+		read.started = true;
+		reading.push_back(&read);
+		readsStarted++;
+
+		// the task keeps the read alive, so it can finish after a cancel or after the loader is gone
+		std::shared_ptr<Read> shared = request->read;
+		read.reading = workerPool().submit([shared] {
+			if (shared->cancelled)
+				return false;
+			if (!Model::readMeshes(shared->path, shared->meshes, shared->nodes, shared->textures, shared->cacheHit))
+				return false;
+			return !shared->cancelled.load();
+		});
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- GL Side
+bool ModelLoader::advance(Request& request)
+{
+	Read& read = *request.read;
+	if (request.model->state != MODEL_LOADING || !read.started)
+		return false;
+
+	if (!read.done) {
+		if (!isReady(read.reading))
+			return false;
+
+		read.done = true;
+		read.succeeded = read.reading.get();
+	}
+
+	// the only user takes the read's data, shared ones get copies until it is down to one
+	bool alone = read.users == 1;
+	if (!request.received) {
+		if (!read.succeeded) {
+			complete(request, read.cancelled ? MODEL_CANCELLED : MODEL_FAILED);
+			return false;
+		}
+
+		request.received = true;
+		// meshes are queued by address between begin and execute, they must not move as the model fills in
+		request.model->meshes.reserve(read.meshes.size());
+		if (alone) {
+			request.model->setNodes(std::move(read.nodes));
+			read.handedOut = true;
+		}
+		else {
+			request.model->setNodes(read.nodes);
+		}
+		return true;
+	}
+
+	// a mesh goes in as soon as its textures are there, so the model shows up piece by piece
+	if (request.nextMesh < read.meshes.size()) {
+		MeshData& data = read.meshes[request.nextMesh];
+		bool texturesLoaded = read.nextTexture == read.textures.size();
+		if (!texturesLoaded) {
+			texturesLoaded = std::all_of(data.materialTextures.begin(), data.materialTextures.end(), [](const TextureReference& reference) {
+				return Model::textures_loaded.count(reference.path) > 0;
+			});
+		}
+
+		if (texturesLoaded) {
+			if (alone) {
+				request.model->addMesh(std::move(data));
+				read.handedOut = true;
+			}
+			else {
+				request.model->addMesh(data);
+			}
+			request.nextMesh++;
+			if (request.firstMeshMilliseconds < 0.0)
+				request.firstMeshMilliseconds = millisecondsSince(request.start);
+			return true;
+		}
+	}
+
+	if (read.nextTexture < read.textures.size()) {
+		Model::PendingTexture& texture = read.textures[read.nextTexture];
+		if (!isReady(texture.image))
+			return false;
+
+		Model::uploadPendingTexture(texture);
+		read.nextTexture++;
+		return true;
+	}
+
+	if (request.nextMesh == read.meshes.size())
+		complete(request, MODEL_READY);
+	return false;
+}
+
+void ModelLoader::complete(Request& request, ModelState state)
+{
+	Read& read = *request.read;
+	request.model->state = state;
+
+	if (state == MODEL_READY) {
+		std::cout << "MODEL: " << read.path << " - " << read.meshes.size() << " meshes, " << read.textures.size()
+			<< " textures in " << millisecondsSince(request.start) << " ms (async, " << (read.cacheHit ? "mesh cache" : "import")
+			<< ", first mesh after " << request.firstMeshMilliseconds << " ms)" << std::endl;
+	}
+	else if (state == MODEL_FAILED) {
+		std::cout << "ERROR - MODELLOADER: COULD NOT LOAD " << read.path << std::endl;
+	}
+
+	// the read stays with the loads still sharing it, the last one lets it go
+	if (--read.users > 0)
+		return;
+	read.cancelled = true;
+
+	// the converted vertices are on the GPU now, or not wanted any more. A read still in flight
+	// owns them until it returns, the read goes with its task then.
+	if (!read.started || read.done) {
+		read.meshes = std::vector<MeshData>();
+		read.nodes = TransformHierarchy();
+		read.textures = std::vector<Model::PendingTexture>();
+	}
+}
+
+void ModelLoader::pump(double budgetMilliseconds)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	startReads();
+
+	for (const std::shared_ptr<Request>& request : requests) {
+		while (millisecondsSince(start) < budgetMilliseconds && advance(*request)) {
+		}
+		if (millisecondsSince(start) >= budgetMilliseconds)
+			break;
+	}
+
+	// a cancelled read still in flight is left to finish on its own, its task holds it
+	requests.erase(std::remove_if(requests.begin(), requests.end(), [](const std::shared_ptr<Request>& request) {
+		return request->model->state != MODEL_LOADING;
+	}), requests.end());
+
+	// slots freed by finished reads go to the next ones right away
+	startReads();
+}
+
+void ModelLoader::finish()
+{
+	while (!requests.empty()) {
+		pump(std::numeric_limits<double>::infinity());
+		if (!requests.empty())
+			std::this_thread::yield();
+	}
+}
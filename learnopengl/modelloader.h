@@ -0,0 +1,98 @@
+#ifndef MODELLOADER_H
+#define MODELLOADER_H
+
+#include "model.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Loads models without stalling the frame. load() hands back an empty model straight away; the
+// worker pool reads the file (mesh cache or Assimp) and decodes its textures, and pump() does the
+// GL side a bit every frame, uploading textures and creating meshes one at a time. Each mesh can be
+// drawn as soon as its textures are in, so a model fills in over a few frames.
+class ModelLoader {
+public:
+	// At most maxImports files are read at once, the rest wait in priority order.
+	explicit ModelLoader(size_t maxImports = 2);
+	// Cancels whatever is left and waits for its worker side to stop.
+	~ModelLoader();
+
+	ModelLoader(const ModelLoader&) = delete;
+	ModelLoader& operator=(const ModelLoader&) = delete;
+
+	// Higher priorities are read and uploaded first, equal ones in the order they were asked for.
+	// Loads of a path that is already being read share that read.
+	std::shared_ptr<Model> load(const std::string& path, int priority = 0);
+	void setPriority(const Model& model, int priority);
+	// Stops the load where it is. Meshes already added stay, the model ends up MODEL_CANCELLED.
+	void cancel(const Model& model);
+
+	// GL thread, once per frame. Spends about budgetMilliseconds on uploads and mesh creation; a
+	// single texture upload is never split, so a frame can run over by one upload.
+	void pump(double budgetMilliseconds);
+	// Pumps without a budget until every load is done, for code that needs the models whole.
+	void finish();
+
+	size_t pendingCount() const { return requests.size(); }
+	// Files handed to the workers so far; loads of a path already being read don't add to it.
+	size_t readCount() const { return readsStarted; }
+	bool idle() const { return requests.empty(); }
+
+private:
+	// One file being read, shared by every load of its path that comes in before a mesh is handed
+	// out, so the same path is never imported, cached or decoded twice at once.
+	struct Read {
+		std::string path;
+		// set once no request wants the result any more
+		std::atomic<bool> cancelled{ false };
+		// requests still loading from it, GL side
+		size_t users = 0;
+
+		// worker side, the vectors below belong to the worker until the future is ready
+		bool started = false;
+		bool done = false;
+		bool succeeded = false;
+		std::future<bool> reading;
+		bool cacheHit = false;
+		std::vector<MeshData> meshes;
+		TransformHierarchy nodes;
+		std::vector<Model::PendingTexture> textures;
+
+		// GL side, textures are uploaded once for all the users
+		size_t nextTexture = 0;
+		// a user that had the read to itself took meshes out of it, a new load can't share it
+		bool handedOut = false;
+	};
+
+	struct Request {
+		std::shared_ptr<Model> model;
+		std::shared_ptr<Read> read;
+		int priority;
+		uint64_t order;
+
+		// GL side progress
+		bool received = false;
+		size_t nextMesh = 0;
+		std::chrono::steady_clock::time_point start;
+		double firstMeshMilliseconds = -1.0;
+	};
+
+	std::vector<std::shared_ptr<Request>> requests;
+	size_t maxImports;
+	uint64_t nextOrder = 0;
+	size_t readsStarted = 0;
+
+	Request* find(const Model& model);
+	void sortRequests();
+	void startReads();
+	// One texture upload or one mesh. False when the request has to wait for the workers or is done.
+	bool advance(Request& request);
+	void complete(Request& request, ModelState state);
+};
+
+#endif //MODELLOADER_H
@@ -0,0 +1,249 @@
+#include "occlusion.h"
+#include "threadpool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+// boxes covering more pixels than this skip the per-pixel test and count as visible
+static const int MAX_FINE_TEST_PIXELS = 64 * 64;
+
+OcclusionCuller::OcclusionCuller()
+{
+	depth.assign(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+	blockDepth.assign(OCCLUSION_BLOCKS_X * OCCLUSION_BLOCKS_Y, 1.0f);
+	tileBins.resize(OCCLUSION_TILES_X * OCCLUSION_TILES_Y);
+}
+
+void OcclusionCuller::begin(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	rendered = false;
+
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(blockDepth.begin(), blockDepth.end(), 1.0f);
+	triangles.clear();
+	for (std::vector<int>& bin : tileBins)
+		bin.clear();
+}
+
+// ---------------------------------------------------------------------------------------------- Occluders
+void OcclusionCuller::addOccluder(const Mesh& mesh, const glm::mat4& model)
+{
+	addOccluder(mesh.vertices, mesh.indices, model);
+}
+
+void OcclusionCuller::addOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& model)
+{
+	glm::mat4 transform = viewProjection * model;
+	clipVertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		clipVertices[i] = transform * glm::vec4(vertices[i].Position, 1.0f);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		ScreenTriangle triangle;
+		bool clipped = false;
+		for (int corner = 0; corner < 3; corner++) {
+			const glm::vec4& clip = clipVertices[indices[i + corner]];
+			// triangles crossing the near plane are dropped, which only ever loses occlusion
+			if (clip.w <= 0.0f || clip.z < -clip.w) {
+				clipped = true;
+				break;
+			}
+
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			triangle.vertices[corner] = glm::vec3(
+				(ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+				(ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT,
+				ndc.z * 0.5f + 0.5f);
+		}
+		if (clipped)
+			continue;
+
+		glm::vec3 minimum = glm::min(triangle.vertices[0], glm::min(triangle.vertices[1], triangle.vertices[2]));
+		glm::vec3 maximum = glm::max(triangle.vertices[0], glm::max(triangle.vertices[1], triangle.vertices[2]));
+		triangle.minX = std::max(0, (int)std::floor(minimum.x));
+		triangle.minY = std::max(0, (int)std::floor(minimum.y));
+		triangle.maxX = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(maximum.x));
+		triangle.maxY = std::min(OCCLUSION_HEIGHT - 1, (int)std::ceil(maximum.y));
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY || minimum.z > 1.0f)
+			continue;
+
+		int index = (int)triangles.size();
+		triangles.push_back(triangle);
+		for (int tileY = triangle.minY / OCCLUSION_TILE_SIZE; tileY <= triangle.maxY / OCCLUSION_TILE_SIZE; tileY++) {
+			for (int tileX = triangle.minX / OCCLUSION_TILE_SIZE; tileX <= triangle.maxX / OCCLUSION_TILE_SIZE; tileX++)
+				tileBins[tileY * OCCLUSION_TILES_X + tileX].push_back(index);
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- Rasterization
+void OcclusionCuller::render()
+{
+	// tiles own disjoint pixels and blocks, so they need no synchronisation
+	workerPool().parallelFor(tileBins.size(), [this](size_t tile) {
+		rasterizeTile((int)tile);
+		buildBlocks((int)tile);
+	});
+
+	rendered = true;
+}
+
+void OcclusionCuller::rasterizeTile(int tile)
+{
+	int minX = (tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_SIZE;
+	int minY = (tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_SIZE;
+
+	for (int index : tileBins[tile])
+		rasterizeTriangle(triangles[index], minX, minY, minX + OCCLUSION_TILE_SIZE - 1, minY + OCCLUSION_TILE_SIZE - 1);
+}
+
+// Edge functions are evaluated at pixel centres and a pixel is covered when all three are >= 0, so
+// shared edges are drawn by both triangles and closed meshes have no cracks.
+void OcclusionCuller::rasterizeTriangle(const ScreenTriangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+	glm::vec3 v0 = triangle.vertices[0];
+	glm::vec3 v1 = triangle.vertices[1];
+	glm::vec3 v2 = triangle.vertices[2];
+
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (std::fabs(area) < 1e-6f)
+		return;
+	// occluders are drawn from both sides, so clockwise triangles are turned around
+	if (area < 0.0f) {
+		std::swap(v1, v2);
+		area = -area;
+	}
+	float inverseArea = 1.0f / area;
+
+	int startX = std::max(triangle.minX, tileMinX) & ~3;
+	int endX = std::min(triangle.maxX, tileMaxX);
+	int startY = std::max(triangle.minY, tileMinY);
+	int endY = std::min(triangle.maxY, tileMaxY);
+
+#if defined(OCCLUSION_SSE)
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (int y = startY; y <= endY; y++) {
+		float* row = &depth[y * OCCLUSION_WIDTH];
+		__m128 py = _mm_set1_ps(y + 0.5f);
+
+		for (int x = startX; x <= endX; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+
+			__m128 w0 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(v2.x - v1.x), _mm_sub_ps(py, _mm_set1_ps(v1.y))),
+				_mm_mul_ps(_mm_set1_ps(v2.y - v1.y), _mm_sub_ps(px, _mm_set1_ps(v1.x))));
+			__m128 w1 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(v0.x - v2.x), _mm_sub_ps(py, _mm_set1_ps(v2.y))),
+				_mm_mul_ps(_mm_set1_ps(v0.y - v2.y), _mm_sub_ps(px, _mm_set1_ps(v2.x))));
+			__m128 w2 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(v1.x - v0.x), _mm_sub_ps(py, _mm_set1_ps(v0.y))),
+				_mm_mul_ps(_mm_set1_ps(v1.y - v0.y), _mm_sub_ps(px, _mm_set1_ps(v0.x))));
+
+			__m128 covered = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+			if (_mm_movemask_ps(covered) == 0)
+				continue;
+
+			__m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(v0.z)), _mm_mul_ps(w1, _mm_set1_ps(v1.z))),
+				_mm_mul_ps(w2, _mm_set1_ps(v2.z))), _mm_set1_ps(inverseArea));
+
+			__m128 current = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_min_ps(current, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(covered, nearest), _mm_andnot_ps(covered, current)));
+		}
+	}
+#else
+	for (int y = startY; y <= endY; y++) {
+		float* row = &depth[y * OCCLUSION_WIDTH];
+		float py = y + 0.5f;
+
+		for (int x = startX; x <= endX; x++) {
+			float px = x + 0.5f;
+			float w0 = (v2.x - v1.x) * (py - v1.y) - (v2.y - v1.y) * (px - v1.x);
+			float w1 = (v0.x - v2.x) * (py - v2.y) - (v0.y - v2.y) * (px - v2.x);
+			float w2 = (v1.x - v0.x) * (py - v0.y) - (v1.y - v0.y) * (px - v0.x);
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			float z = (w0 * v0.z + w1 * v1.z + w2 * v2.z) * inverseArea;
+			row[x] = std::min(row[x], z);
+		}
+	}
+#endif
+}
+
+void OcclusionCuller::buildBlocks(int tile)
+{
+	const int blocksPerTile = OCCLUSION_TILE_SIZE / OCCLUSION_BLOCK_SIZE;
+	int firstBlockX = (tile % OCCLUSION_TILES_X) * blocksPerTile;
+	int firstBlockY = (tile / OCCLUSION_TILES_X) * blocksPerTile;
+
+	for (int blockY = firstBlockY; blockY < firstBlockY + blocksPerTile; blockY++) {
+		for (int blockX = firstBlockX; blockX < firstBlockX + blocksPerTile; blockX++) {
+			float farthest = 0.0f;
+			for (int y = 0; y < OCCLUSION_BLOCK_SIZE; y++) {
+				const float* row = &depth[(blockY * OCCLUSION_BLOCK_SIZE + y) * OCCLUSION_WIDTH + blockX * OCCLUSION_BLOCK_SIZE];
+				for (int x = 0; x < OCCLUSION_BLOCK_SIZE; x++)
+					farthest = std::max(farthest, row[x]);
+			}
+			blockDepth[blockY * OCCLUSION_BLOCKS_X + blockX] = farthest;
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- Queries
+bool OcclusionCuller::isVisible(const AABB& box) const
+{
+	if (!rendered)
+		return true;
+
+	glm::vec3 minimum(FLT_MAX);
+	glm::vec3 maximum(-FLT_MAX);
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 point((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+			return true;
+
+		glm::vec3 screen = glm::vec3(clip) / clip.w;
+		screen = glm::vec3(
+			(screen.x * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+			(screen.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT,
+			screen.z * 0.5f + 0.5f);
+		minimum = glm::min(minimum, screen);
+		maximum = glm::max(maximum, screen);
+	}
+
+	int minX = std::max(0, (int)std::floor(minimum.x));
+	int minY = std::max(0, (int)std::floor(minimum.y));
+	int maxX = std::min(OCCLUSION_WIDTH - 1, (int)std::floor(maximum.x));
+	int maxY = std::min(OCCLUSION_HEIGHT - 1, (int)std::floor(maximum.y));
+	if (minX > maxX || minY > maxY)
+		return true;
+
+	// coarse level: the farthest occluder depth over every block the box touches
+	float farthest = 0.0f;
+	for (int blockY = minY / OCCLUSION_BLOCK_SIZE; blockY <= maxY / OCCLUSION_BLOCK_SIZE; blockY++) {
+		for (int blockX = minX / OCCLUSION_BLOCK_SIZE; blockX <= maxX / OCCLUSION_BLOCK_SIZE; blockX++)
+			farthest = std::max(farthest, blockDepth[blockY * OCCLUSION_BLOCKS_X + blockX]);
+	}
+	if (minimum.z > farthest)
+		return false;
+
+	// the blocks reach past the box, so look at the pixels it actually covers
+	if ((maxX - minX + 1) * (maxY - minY + 1) > MAX_FINE_TEST_PIXELS)
+		return true;
+
+	for (int y = minY; y <= maxY; y++) {
+		const float* row = &depth[y * OCCLUSION_WIDTH];
+		for (int x = minX; x <= maxX; x++) {
+			if (row[x] >= minimum.z)
+				return true;
+		}
+	}
+	return false;
+}
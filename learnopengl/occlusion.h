@@ -0,0 +1,69 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "mesh.h"
+
+#include <vector>
+
+// ---------------------------------------------------------------------------------------------- Depth Buffer Layout
+// The screen is split into tiles rasterized in parallel, and each tile into blocks whose farthest
+// depth forms the coarse level of the hierarchical buffer.
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+const int OCCLUSION_TILE_SIZE = 64;
+const int OCCLUSION_BLOCK_SIZE = 8;
+
+const int OCCLUSION_TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_SIZE;
+const int OCCLUSION_TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_SIZE;
+const int OCCLUSION_BLOCKS_X = OCCLUSION_WIDTH / OCCLUSION_BLOCK_SIZE;
+const int OCCLUSION_BLOCKS_Y = OCCLUSION_HEIGHT / OCCLUSION_BLOCK_SIZE;
+
+// CPU depth-only rasterizer for occlusion culling. Selected occluders are drawn into a small depth
+// buffer every frame, then boxes are tested against it before their meshes are sent to GL.
+// Depth is 0 at the near plane and 1 at the far plane. Nothing here touches OpenGL.
+class OcclusionCuller {
+public:
+	OcclusionCuller();
+
+	// Clears the buffers and sets the camera for this frame's occluders and tests.
+	void begin(const glm::mat4& viewProjection);
+
+	void addOccluder(const Mesh& mesh, const glm::mat4& model);
+	void addOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& model);
+
+	// Rasterizes every occluder on the worker pool and builds the coarse depth level.
+	void render();
+
+	// False only when the whole box is behind the occluders. Boxes crossing the near plane are visible.
+	bool isVisible(const AABB& box) const;
+	bool isRendered() const { return rendered; }
+
+	const std::vector<float>& getDepth() const { return depth; }
+	size_t triangleCount() const { return triangles.size(); }
+
+private:
+	// screen space position, pixel centres at +0.5, with depth in z
+	struct ScreenTriangle {
+		glm::vec3 vertices[3];
+		int minX, minY, maxX, maxY;
+	};
+
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	bool rendered = false;
+
+	std::vector<float> depth;
+	std::vector<float> blockDepth;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<int>> tileBins;
+
+	std::vector<glm::vec4> clipVertices;
+
+	void rasterizeTile(int tile);
+	void rasterizeTriangle(const ScreenTriangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+	void buildBlocks(int tile);
+};
+
+#endif //OCCLUSION_H
@@ -0,0 +1,268 @@
+#include "renderqueue.h"
+#include "glstate.h"
+#include "glextensions.h"
+
+void RenderQueue::begin(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	this->view = view;
+	viewProjection = projection * view;
+	frustum = Frustum::fromMatrix(viewProjection);
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	items.clear();
+	culler.clear();
+	itemBounds.clear();
+}
+
+int RenderQueue::programIndex(Shader& shader)
+{
+	// programs keep their index for the lifetime of the queue so the order is stable between frames
+	for (size_t i = 0; i < programs.size(); i++) {
+		if (programs[i].shader == &shader)
+			return (int)i;
+	}
+
+	programs.push_back({ &shader, shader.uniform<glm::mat4>("model"), shader.uniform<glm::mat3>("normalMatrix"),
+		shader.uniform<glm::mat4>("modelViewProjection"), NULL });
+	return (int)programs.size() - 1;
+}
+
+void RenderQueue::setMultiDrawVariant(Shader& shader, Shader& multiDrawShader)
+{
+	programs[programIndex(shader)].multiDrawShader = &multiDrawShader;
+}
+
+bool RenderQueue::isMultiDrawActive() const
+{
+	return multiDraw && GLEXT_ARB_multi_draw_indirect;
+}
+
+uint32_t RenderQueue::quantizeDepth(float depth) const
+{
+	float normalized = (depth - nearPlane) / (farPlane - nearPlane);
+	normalized = glm::clamp(normalized, 0.0f, 1.0f);
+
+	return (uint32_t)(normalized * ((1u << SORT_DEPTH_BITS) - 1));
+}
+
+void RenderQueue::submit(Mesh& mesh, Shader& shader, const glm::mat4& model)
+{
+	if (mesh.bounds.isEmpty())
+		return;
+
+	int program = programIndex(shader);
+
+	AABB worldBounds = mesh.bounds.transformed(model);
+	culler.add(worldBounds);
+	itemBounds.push_back(worldBounds);
+
+	glm::vec4 viewPosition = view * glm::vec4(worldBounds.center(), 1.0f);
+	uint32_t depth = quantizeDepth(-viewPosition.z);
+
+	uint64_t material = mesh.materialKey() & 0xFFFF;
+	uint64_t vao = mesh.getVAO() & 0xFFFF;
+
+	uint64_t key;
+	if (mesh.transparent) {
+		uint64_t farToNear = ((1u << SORT_DEPTH_BITS) - 1) - depth;
+		key = ((uint64_t)PASS_TRANSPARENT << 62) | (farToNear << 40) | ((uint64_t)(program & 0xFF) << 32) | (material << 16) | vao;
+	}
+	else {
+		key = ((uint64_t)PASS_OPAQUE << 62) | ((uint64_t)(program & 0xFF) << 54) | (material << 38) | (vao << 22) | depth;
+	}
+
+	items.push_back({ key, &mesh, program, model });
+}
+
+void RenderQueue::radixSort()
+{
+	sorted.clear();
+	for (size_t i = 0; i < items.size(); i++) {
+		if (visible[i])
+			sorted.push_back({ items[i].key, (uint32_t)i });
+	}
+	scratch.resize(sorted.size());
+
+	// LSD radix sort, 8 bits per pass. Passes where every key has the same byte are skipped.
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t counts[256] = {};
+		for (const SortEntry& entry : sorted)
+			counts[(entry.key >> shift) & 0xFF]++;
+
+		if (counts[(sorted[0].key >> shift) & 0xFF] == sorted.size())
+			continue;
+
+		size_t offset = 0;
+		for (int i = 0; i < 256; i++) {
+			size_t count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+
+		for (const SortEntry& entry : sorted)
+			scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+
+		sorted.swap(scratch);
+	}
+}
+
+void RenderQueue::execute()
+{
+	if (items.empty())
+		return;
+
+	size_t visibleCount = culler.cull(frustum, visible);
+	stats.submitted += items.size();
+
+	if (occlusion && occlusion->isRendered()) {
+		for (size_t i = 0; i < items.size(); i++) {
+			if (visible[i] && !occlusion->isVisible(itemBounds[i])) {
+				visible[i] = 0;
+				visibleCount--;
+				stats.occluded++;
+			}
+		}
+	}
+
+	stats.visible += visibleCount;
+	if (visibleCount == 0) {
+		items.clear();
+		culler.clear();
+		itemBounds.clear();
+		return;
+	}
+
+	radixSort();
+	computeMatrices();
+	buildBatches();
+	uploadBatches();
+
+	int pass = -1;
+	for (const Batch& batch : batches) {
+		const DrawItem& item = items[sorted[batch.first].item];
+
+		int itemPass = (int)(item.key >> 62);
+		if (itemPass != pass) {
+			bool transparent = itemPass == PASS_TRANSPARENT;
+			glState.setBlend(transparent);
+			glState.depthMask(!transparent);
+			if (transparent)
+				glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			pass = itemPass;
+		}
+
+		drawBatch(batch);
+	}
+
+	glState.setBlend(false);
+	glState.depthMask(true);
+	items.clear();
+	culler.clear();
+	itemBounds.clear();
+}
+
+void RenderQueue::computeMatrices()
+{
+	drawModels.resize(sorted.size());
+	drawLocals.resize(sorted.size());
+	matrices.resize(sorted.size());
+	for (size_t s = 0; s < sorted.size(); s++) {
+		const DrawItem& item = items[sorted[s].item];
+		drawModels[s] = item.model;
+		drawLocals[s] = item.mesh->getDequantization();
+	}
+
+	computeDrawMatrices(viewProjection, drawModels.data(), drawLocals.data(), sorted.size(), matrices.data());
+}
+
+// ---------------------------------------------------------------------------------------------- Multi Draw
+bool RenderQueue::canBatch(const DrawItem& first, const DrawItem& item) const
+{
+	// the sort already put these next to each other, except where the depth order of blended items
+	// interleaves them
+	return (item.key >> 62) == (first.key >> 62) && item.program == first.program
+		&& item.mesh->getIndexType() == first.mesh->getIndexType() && item.mesh->getVAO() == first.mesh->getVAO()
+		&& item.mesh->sameMaterial(*first.mesh);
+}
+
+void RenderQueue::buildBatches()
+{
+	batches.clear();
+	commands.clear();
+	drawData.clear();
+
+	bool indirect = isMultiDrawActive();
+	if (indirect && drawDataAlignment == 0) {
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		// the fewest entries whose size is a multiple of the alignment, 4 for the common 256 bytes
+		drawDataAlignment = 1;
+		while (alignment > 0 && (drawDataAlignment * sizeof(DrawMatrices)) % alignment != 0)
+			drawDataAlignment++;
+	}
+
+	for (size_t s = 0; s < sorted.size();) {
+		const DrawItem& first = items[sorted[s].item];
+		if (!indirect || !programs[first.program].multiDrawShader) {
+			batches.push_back({ s, 1, false, 0, 0 });
+			s++;
+			continue;
+		}
+
+		while (drawData.size() % drawDataAlignment != 0)
+			drawData.emplace_back();
+
+		Batch batch = { s, 0, true, commands.size(), drawData.size() };
+		for (; s < sorted.size() && canBatch(first, items[sorted[s].item]); s++) {
+			DrawElementsIndirectCommand command = items[sorted[s].item].mesh->indirectCommand();
+			command.instanceCount = 1;
+
+			commands.push_back(command);
+			drawData.push_back(matrices[s]);
+			batch.count++;
+		}
+		batches.push_back(batch);
+	}
+}
+
+void RenderQueue::uploadBatches()
+{
+	if (commands.empty())
+		return;
+
+	if (commandBuffer == 0) {
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &drawDataBuffer);
+	}
+
+	// orphaned every frame, the driver hands out fresh memory while last frame's draws still read the old
+	glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+	glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawMatrices), drawData.data(), GL_STREAM_DRAW);
+}
+
+void RenderQueue::drawBatch(const Batch& batch)
+{
+	const DrawItem& item = items[sorted[batch.first].item];
+	Program& program = programs[item.program];
+
+	if (!batch.indirect) {
+		const DrawMatrices& drawMatrices = matrices[batch.first];
+		program.shader->set(program.model, drawMatrices.model);
+		program.shader->set(program.normalMatrix, glm::mat3(drawMatrices.normalMatrix));
+		program.shader->set(program.modelViewProjection, drawMatrices.modelViewProjection);
+		item.mesh->Draw(*program.shader);
+		return;
+	}
+
+	// gl_DrawIDARB counts from 0 in every call, so the batch's draw data is bound as a range
+	Shader& shader = *program.multiDrawShader;
+	item.mesh->bindMaterial(shader);
+	shader.flush();
+	glState.bindVertexArray(item.mesh->getVAO());
+	glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer, batch.drawData * sizeof(DrawMatrices), batch.count * sizeof(DrawMatrices));
+	glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, item.mesh->getIndexType(), (void*)(batch.command * sizeof(DrawElementsIndirectCommand)), (GLsizei)batch.count, 0);
+	glState.countDraw();
+}
@@ -0,0 +1,135 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+#include "bounds.h"
+#include "culling.h"
+#include "drawmatrices.h"
+#include "occlusion.h"
+
+#include <cstdint>
+#include <vector>
+
+enum RenderPass {
+	PASS_OPAQUE			= 0,
+	PASS_TRANSPARENT	= 1
+};
+
+// ---------------------------------------------------------------------------------------------- Sort Key
+// 63-62 pass, then for opaque items:      61-54 program | 53-38 material | 37-22 VAO | 21-0 depth
+//                 for transparent items:  61-40 far-to-near depth | 39-32 program | 31-16 material | 15-0 VAO
+// Sorting ascending draws opaque work grouped by state and front to back, then blended work back to front.
+const int SORT_DEPTH_BITS = 22;
+
+struct DrawItem {
+	uint64_t key;
+	Mesh* mesh;
+	int program;
+	glm::mat4 model;
+};
+
+// Shader storage binding of the per-draw DrawMatrices buffer, see model_loading.vert.
+const GLuint DRAW_DATA_BINDING = 0;
+
+// Items seen by execute() since the last resetStats().
+struct CullStats {
+	unsigned long long submitted = 0;
+	unsigned long long visible = 0;
+	unsigned long long occluded = 0;
+};
+
+class RenderQueue {
+public:
+	// Camera used to cull and compute item depth for the next batch of submissions.
+	void begin(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane);
+	void submit(Mesh& mesh, Shader& shader, const glm::mat4& model);
+
+	// Culls the submitted items against the frustum in one batch, then against the occlusion buffer
+	// when one is set and rendered, sorts the visible ones and draws them in one pass, then empties
+	// the queue.
+	void execute();
+
+	void setOcclusion(const OcclusionCuller* occlusion) { this->occlusion = occlusion; }
+
+	// Items submitted with shader are drawn with multiDrawShader, its MULTI_DRAW variant, in batches:
+	// a run of sorted items with the same pass, textures, arena and index type becomes one
+	// glMultiDrawElementsIndirect. Ignored without GLEXT_ARB_multi_draw_indirect, and programs without
+	// a variant keep drawing mesh by mesh either way.
+	void setMultiDrawVariant(Shader& shader, Shader& multiDrawShader);
+	// On by default, off draws every item on its own like a GL 3.3 context does.
+	void setMultiDraw(bool enabled) { multiDraw = enabled; }
+	bool isMultiDrawActive() const;
+
+	size_t size() const { return items.size(); }
+	const Frustum& getFrustum() const { return frustum; }
+
+	const CullStats& getStats() const { return stats; }
+	void resetStats() { stats = CullStats(); }
+
+private:
+	struct Program {
+		Shader* shader;
+		UniformHandle<glm::mat4> model;
+		UniformHandle<glm::mat3> normalMatrix;
+		UniformHandle<glm::mat4> modelViewProjection;
+		Shader* multiDrawShader;
+	};
+
+	// A run of sorted entries drawn together, or a single one drawn on its own.
+	struct Batch {
+		size_t first;
+		size_t count;
+		bool indirect;
+		size_t command;		// first DrawElementsIndirectCommand
+		size_t drawData;	// first DrawMatrices, aligned for glBindBufferRange
+	};
+
+	struct SortEntry {
+		uint64_t key;
+		uint32_t item;
+	};
+
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	Frustum frustum = Frustum::fromMatrix(glm::mat4(1.0f));
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+
+	std::vector<Program> programs;
+	std::vector<DrawItem> items;
+	std::vector<SortEntry> sorted;
+	std::vector<SortEntry> scratch;
+	// one entry per sorted entry, filled in a single pass before anything is drawn
+	std::vector<glm::mat4> drawModels;
+	std::vector<glm::mat4> drawLocals;
+	std::vector<DrawMatrices> matrices;
+
+	FrustumCuller culler;
+	std::vector<AABB> itemBounds;
+	std::vector<uint8_t> visible;
+	const OcclusionCuller* occlusion = NULL;
+	CullStats stats;
+
+	bool multiDraw = true;
+	std::vector<Batch> batches;
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<DrawMatrices> drawData;
+	GLuint commandBuffer = 0;
+	GLuint drawDataBuffer = 0;
+	size_t drawDataAlignment = 0;	// in DrawMatrices entries
+
+	int programIndex(Shader& shader);
+	uint32_t quantizeDepth(float depth) const;
+	void radixSort();
+	void computeMatrices();
+	bool canBatch(const DrawItem& first, const DrawItem& item) const;
+	// Splits the sorted entries into batches and fills the indirect commands and draw data.
+	void buildBatches();
+	void uploadBatches();
+	void drawBatch(const Batch& batch);
+};
+
+#endif //RENDERQUEUE_H
@@ -5,6 +5,13 @@ struct Material {
     float shininess;
 }; 
 
+layout (std140) uniform Frame {
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	mat4 viewProjection;
+};
+
 struct DirLight {
 	vec3 direction;
 
@@ -12,40 +19,44 @@ struct DirLight {
 	vec3 diffuse;
 	vec3 specular;
 };
-uniform DirLight dirLight;
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 
 struct PointLight {
 	vec3 position;
-
 	float constant;
-	float linear;
-	float quadratic;
 
 	vec3 ambient;
+	float linear;
 	vec3 diffuse;
+	float quadratic;
 	vec3 specular;
 };
-#define NR_POINT_LIGHTS 4
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 struct SpotLight {
 	vec3 position;
-	vec3 direction;
 	float innerCutoff;
+	vec3 direction;
 	float outerCutoff;
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
+	vec3 ambient;
 	float constant;
+	vec3 diffuse;
 	float linear;
+	vec3 specular;
 	float quadratic;
 };
-#define NR_SPOT_LIGHTS 1
-uniform SpotLight spotLights[NR_SPOT_LIGHTS];
+
+#define MAX_POINT_LIGHTS 4
+#define MAX_SPOT_LIGHTS 4
+layout (std140) uniform Lights {
+	DirLight dirLight;
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	SpotLight spotLights[MAX_SPOT_LIGHTS];
+	int numPointLights;
+	int numSpotLights;
+};
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 in vec3 Normal;
@@ -53,7 +64,6 @@ in vec3 FragPos;
 in vec2 TexCoords;
 
 uniform Material material;
-uniform vec3 viewPos;
 
 out vec4 FragColor;
 
@@ -64,11 +74,20 @@ void main()
 
 	vec3 result = CalcDirLight(dirLight, norm, viewDir);
 	
+	// variants that know the exact light counts get loops the compiler can unroll
+#ifdef NR_POINT_LIGHTS
 	for (int i = 0; i < NR_POINT_LIGHTS; i++) {
+#else
+	for (int i = 0; i < numPointLights; i++) {
+#endif
 		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
 	}
 
+#ifdef NR_SPOT_LIGHTS
 	for (int i = 0; i < NR_SPOT_LIGHTS; i++) {
+#else
+	for (int i = 0; i < numSpotLights; i++) {
+#endif
 		result += CalcSpotLight(spotLights[i], norm, FragPos, viewDir);
 	}
 	
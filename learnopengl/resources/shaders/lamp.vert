@@ -2,11 +2,16 @@
 #extension GL_ARB_separate_shader_objects : enable
 layout (location = 0) in vec3 aPos;
 	
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Frame {
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	mat4 viewProjection;
+};
+
+uniform mat4 modelViewProjection;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = modelViewProjection * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -3,21 +3,61 @@
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+#ifdef ALPHA_MAP
+    sampler2D texture_opacity1;
+#endif
+};
+
+layout (std140) uniform Frame {
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	mat4 viewProjection;
+};
+
+struct DirLight {
+	vec3 direction;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
 };
 
 struct PointLight {
 	vec3 position;
-
 	float constant;
+
+	vec3 ambient;
 	float linear;
+	vec3 diffuse;
 	float quadratic;
+	vec3 specular;
+};
+
+struct SpotLight {
+	vec3 position;
+	float innerCutoff;
+	vec3 direction;
+	float outerCutoff;
 
 	vec3 ambient;
+	float constant;
 	vec3 diffuse;
+	float linear;
 	vec3 specular;
+	float quadratic;
 };
-#define NR_POINT_LIGHTS 1
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+
+#define MAX_POINT_LIGHTS 4
+#define MAX_SPOT_LIGHTS 4
+layout (std140) uniform Lights {
+	DirLight dirLight;
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	SpotLight spotLights[MAX_SPOT_LIGHTS];
+	int numPointLights;
+	int numSpotLights;
+};
+
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 in vec3 Normal;
@@ -25,7 +65,6 @@ in vec3 FragPos;
 in vec2 TexCoords;
 
 uniform Material material;
-uniform vec3 viewPos;
 
 out vec4 FragColor;
 
@@ -35,9 +74,21 @@ void main()
     vec3 viewDir = normalize(viewPos - FragPos);
 
     vec3 result = vec3(0.0);
-    result += CalcPointLight(pointLights[0], norm, FragPos, viewDir);
+    // variants that know the exact light count get a loop the compiler can unroll
+#ifdef NR_POINT_LIGHTS
+    for (int i = 0; i < NR_POINT_LIGHTS; i++) {
+#else
+    for (int i = 0; i < numPointLights; i++) {
+#endif
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    }
 
-    FragColor = vec4(result, 1.0);
+#ifdef ALPHA_MAP
+    float alpha = texture(material.texture_opacity1, TexCoords).r;
+#else
+    float alpha = 1.0;
+#endif
+    FragColor = vec4(result, alpha);
 }
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
@@ -1,12 +1,45 @@
 #version 330 core
+#ifdef MULTI_DRAW
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shading_language_420pack : require
+#endif
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef INSTANCED
+layout (location = 3) in mat4 aInstanceModel;
+layout (location = 7) in mat3 aInstanceNormal;
+#endif
 
+layout (std140) uniform Frame {
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	mat4 viewProjection;
+};
+
+// computed per draw on the CPU with the mesh dequantization folded in, see DrawMatrices
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform bool flipUV;
+uniform mat3 normalMatrix;
+uniform mat4 modelViewProjection;
+#ifdef MULTI_DRAW
+// one entry per draw of a glMultiDrawElementsIndirect call, see DrawMatrices in drawmatrices.h
+struct DrawData {
+	mat4 model;
+	mat4 normalMatrix;
+	mat4 modelViewProjection;
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+	DrawData draws[];
+};
+#endif
+#ifdef INSTANCED
+// the instance matrices are per model, these place the mesh in it: its node, then its dequantization
+uniform mat4 meshModel;
+uniform mat3 meshNormalMatrix;
+#endif
 
 out vec2 TexCoords;
 out vec3 FragPos;
@@ -15,10 +48,23 @@ out vec3 Normal;
 void main()
 {
     TexCoords = aTexCoords;
-    if (flipUV)
-        TexCoords.y = 1.0 - TexCoords.y;
+#ifdef FLIP_UV
+    TexCoords.y = 1.0 - TexCoords.y;
+#endif
 
+    // only matrix-vector products per vertex, every matrix-matrix product is done before the draw
+#if defined(INSTANCED)
+    vec4 worldPos = aInstanceModel * (meshModel * vec4(aPos, 1.0));
+    FragPos = vec3(worldPos);
+    Normal = aInstanceNormal * (meshNormalMatrix * aNormal);
+    gl_Position = viewProjection * worldPos;
+#elif defined(MULTI_DRAW)
+    FragPos = vec3(draws[gl_DrawIDARB].model * vec4(aPos, 1.0));
+    Normal = mat3(draws[gl_DrawIDARB].normalMatrix) * aNormal;
+    gl_Position = draws[gl_DrawIDARB].modelViewProjection * vec4(aPos, 1.0);
+#else
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    Normal = normalMatrix * aNormal;
+    gl_Position = modelViewProjection * vec4(aPos, 1.0);
+#endif
 }
\ No newline at end of file
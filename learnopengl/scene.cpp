@@ -0,0 +1,91 @@
+#include "scene.h"
+
+int Scene::add(Model& model, Shader& shader, const glm::mat4& transform, Shader* transparentShader)
+{
+	objects.push_back({ &model, &shader, transparentShader, transform, false, model.getRevision() });
+	needsBuild = true;
+
+	int object = (int)objects.size() - 1;
+	if (model.getState() == MODEL_LOADING)
+		loading.push_back(object);
+
+	return object;
+}
+
+void Scene::setTransform(int object, const glm::mat4& transform)
+{
+	objects[object].transform = transform;
+	if (!needsBuild)
+		bvh.update(object, worldBounds(objects[object]));
+}
+
+void Scene::setOccluder(int object, bool occluder)
+{
+	objects[object].occluder = occluder;
+}
+
+AABB Scene::worldBounds(const SceneObject& object) const
+{
+	return object.model->getBounds().transformed(object.transform);
+}
+
+void Scene::updateBounds()
+{
+	// moved nodes change the model's box without it ever loading again, so every object is checked.
+	// Models drawn by several objects are only updated by the first, the rest see the new revision.
+	for (size_t i = 0; i < objects.size(); i++) {
+		SceneObject& object = objects[i];
+		object.model->updateNodes();
+		if (object.revision != object.model->getRevision()) {
+			object.revision = object.model->getRevision();
+			if (!needsBuild)
+				bvh.update((int)i, worldBounds(object));
+		}
+	}
+
+	for (size_t i = 0; i < loading.size();) {
+		if (objects[loading[i]].model->getState() == MODEL_LOADING) {
+			i++;
+			continue;
+		}
+
+		// refits only grew the boxes of the partial models, the final ones get a proper tree
+		needsBuild = true;
+		loading[i] = loading.back();
+		loading.pop_back();
+	}
+}
+
+void Scene::submit(RenderQueue& queue, OcclusionCuller* occlusion)
+{
+	updateBounds();
+
+	if (needsBuild) {
+		std::vector<AABB> boxes;
+		boxes.reserve(objects.size());
+		for (const SceneObject& object : objects)
+			boxes.push_back(worldBounds(object));
+
+		bvh.build(boxes);
+		needsBuild = false;
+	}
+	else {
+		bvh.refit();
+	}
+
+	visible.clear();
+	bvh.cull(queue.getFrustum(), visible);
+
+	if (occlusion) {
+		for (int index : visible) {
+			if (objects[index].occluder)
+				objects[index].model->AddOccluders(*occlusion, objects[index].transform);
+		}
+		occlusion->render();
+	}
+
+	for (int index : visible) {
+		SceneObject& object = objects[index];
+		object.model->Submit(queue, *object.shader, object.transform, object.transparentShader);
+	}
+}
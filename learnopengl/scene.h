@@ -0,0 +1,59 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "model.h"
+#include "occlusion.h"
+#include "renderqueue.h"
+#include "shader.h"
+
+#include <vector>
+
+struct SceneObject {
+	Model* model;
+	Shader* shader;
+	Shader* transparentShader;
+	glm::mat4 transform;
+	bool occluder;
+	// model revision the tree's box was made from
+	unsigned int revision;
+};
+
+// Placed models. A BVH over their world space boxes decides which ones reach the render queue, the
+// queue then culls their meshes individually.
+class Scene {
+public:
+	// Returns the handle used by setTransform. Adding objects rebuilds the tree on the next submit.
+	// Models still loading can be added, their boxes follow the meshes as they come in.
+	int add(Model& model, Shader& shader, const glm::mat4& transform, Shader* transparentShader = NULL);
+	// Moving objects only refits the tree.
+	void setTransform(int object, const glm::mat4& transform);
+
+	// Occluders are drawn into the occlusion buffer when they are inside the frustum.
+	void setOccluder(int object, bool occluder);
+
+	// Submits every object inside the frustum the queue was begun with. Node transforms set on the
+	// models since the last submit are applied first. When an occlusion culler is
+	// given, the visible occluders are rendered into it first, ready for the queue's per-mesh tests.
+	void submit(RenderQueue& queue, OcclusionCuller* occlusion = NULL);
+
+	size_t size() const { return objects.size(); }
+	size_t visibleCount() const { return visible.size(); }
+
+private:
+	std::vector<SceneObject> objects;
+	BVH bvh;
+	bool needsBuild = false;
+	std::vector<int> visible;
+	// objects whose model is still loading
+	std::vector<int> loading;
+
+	AABB worldBounds(const SceneObject& object) const;
+	// Applies moved nodes and refits the objects whose model box changed since the last submit.
+	void updateBounds();
+};
+
+#endif //SCENE_H
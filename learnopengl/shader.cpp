@@ -1,9 +1,280 @@
 #include "shader.h"
+#include "uniformbuffer.h"
+#include "glextensions.h"
+#include "hash.h"
+#include "glstate.h"
+#include "mappedfile.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <iterator>
+#include <thread>
+
+std::string Shader::cacheDirectory = "shadercache";
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines)
+	: Shader(ShaderSource::fromFiles(vertexPath, fragmentPath), defines)
+{
+}
+
+Shader::Shader(const ShaderSource& source, const ShaderDefines& defines)
+{
+	name = source.name;
+	for (const auto& define : defines)
+		name += (define.second.empty() ? " " + define.first : " " + define.first + "=" + define.second);
+
+	submitTime = std::chrono::steady_clock::now();
+
+	if (!source.computeCode.empty()) {
+		std::string computeCode = injectDefines(source.computeCode, defines);
+		binaryKey = cacheKey(computeCode, "");
+		cacheHit = loadBinary(binaryKey);
+		if (!cacheHit)
+			linkCompute(computeCode);
+		return;
+	}
+
+	std::string vertexCode = injectDefines(source.vertexCode, defines);
+	std::string fragmentCode = injectDefines(source.fragmentCode, defines);
+
+	// only submit here, nothing queries compile or link state until the program is finished
+	binaryKey = cacheKey(vertexCode, fragmentCode);
+	cacheHit = loadBinary(binaryKey);
+	if (!cacheHit)
+		link(vertexCode, fragmentCode);
+}
+
+bool Shader::isReady()
+{
+	if (ready)
+		return true;
+
+	if (GLEXT_KHR_parallel_shader_compile) {
+		GLint completed = GL_FALSE;
+		glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+		if (!completed)
+			return false;
+	}
+
+	finish();
+	return true;
+}
+
+void Shader::wait()
 {
-	std::string vertexCode;
-	std::string fragmentCode;
+	if (!ready)
+		finish();
+}
+
+void Shader::finish()
+{
+	if (!cacheHit) {
+		if (pendingCompute != 0) {
+			checkShader(GL_COMPUTE_SHADER, pendingCompute);
+		}
+		else {
+			checkShader(GL_VERTEX_SHADER, pendingVertex);
+			checkShader(GL_FRAGMENT_SHADER, pendingFragment);
+		}
+
+		int success;
+		char infoLog[512];
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(ID, 512, NULL, infoLog);
+			std::cout << "ERROR - SHADER: PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		}
+
+		glDeleteShader(pendingVertex);
+		glDeleteShader(pendingFragment);
+		glDeleteShader(pendingCompute);
+		pendingVertex = 0;
+		pendingFragment = 0;
+		pendingCompute = 0;
+
+		if (success)
+			saveBinary(binaryKey);
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitTime).count();
+	std::cout << "SHADER: " << name << " - binary cache " << (cacheHit ? "hit" : "miss") << " (" << milliseconds << " ms)" << std::endl;
+
+	bindUniformBlocks();
+	loadUniforms();
+	ready = true;
+}
+
+void Shader::warmUp()
+{
+	wait();
+
+	// a throwaway point with every write masked off makes the driver build its draw-time state
+	// for this program now instead of on the first real frame
+	static unsigned int emptyVAO = 0;
+	if (emptyVAO == 0)
+		glGenVertexArrays(1, &emptyVAO);
+
+	glState.colorMask(false);
+	glState.depthMask(false);
+
+	glState.useProgram(ID);
+	glState.bindVertexArray(emptyVAO);
+	glDrawArrays(GL_POINTS, 0, 1);
+
+	glState.colorMask(true);
+	glState.depthMask(true);
+}
+
+std::string Shader::injectDefines(const std::string& code, const ShaderDefines& defines)
+{
+	if (defines.empty())
+		return code;
+
+	std::string block;
+	for (const auto& define : defines)
+		block += "#define " + define.first + " " + define.second + "\n";
+
+	// #version has to stay the first directive, everything else may follow it
+	size_t version = code.find("#version");
+	if (version == std::string::npos)
+		return block + code;
+
+	size_t lineEnd = code.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return code + "\n" + block;
+
+	return code.substr(0, lineEnd + 1) + block + code.substr(lineEnd + 1);
+}
+
+void Shader::link(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	const char* vShaderCode = vertexCode.c_str();
+	const char* fShaderCode = fragmentCode.c_str();
+
+	pendingVertex = compile(GL_VERTEX_SHADER, vShaderCode);
+	pendingFragment = compile(GL_FRAGMENT_SHADER, fShaderCode);
+
+	ID = glCreateProgram();
+	glAttachShader(ID, pendingVertex);
+	glAttachShader(ID, pendingFragment);
+	if (GLEXT_ARB_get_program_binary)
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(ID);
+}
+
+void Shader::linkCompute(const std::string& computeCode)
+{
+	pendingCompute = compile(GL_COMPUTE_SHADER, computeCode.c_str());
+
+	ID = glCreateProgram();
+	glAttachShader(ID, pendingCompute);
+	if (GLEXT_ARB_get_program_binary)
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(ID);
+}
+
+// ---------------------------------------------------------------------------------------------- Binary Cache
+std::string Shader::cacheKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	// a binary is only valid for the exact source (defines included) on the exact driver that produced it
+	uint64_t hash = hashString(vertexCode);
+	hash = hashString(fragmentCode, hash);
+	hash = hashString((const char*)glGetString(GL_VENDOR), hash);
+	hash = hashString((const char*)glGetString(GL_RENDERER), hash);
+	hash = hashString((const char*)glGetString(GL_VERSION), hash);
+
+	return hashToHex(hash);
+}
+
+bool Shader::loadBinary(const std::string& key)
+{
+	if (!GLEXT_ARB_get_program_binary)
+		return false;
+
+	std::ifstream file(cacheDirectory + "/" + key + ".bin", std::ios::binary);
+	if (!file)
+		return false;
+
+	GLenum format = 0;
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	if (!file)
+		return false;
+
+	// the iterators read the stream buffer directly, they never set the stream's eofbit
+	std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (binary.empty())
+		return false;
+
+	ID = glCreateProgram();
+	glProgramBinary(ID, format, binary.data(), (GLsizei)binary.size());
+
+	int success;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success) {
+		// driver update or foreign binary, fall back to compiling from source
+		std::cout << "SHADER: " << name << " - cached binary rejected, recompiling." << std::endl;
+		glDeleteProgram(ID);
+		ID = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void Shader::saveBinary(const std::string& key) const
+{
+	if (!GLEXT_ARB_get_program_binary)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(ID, length, &written, &format, binary.data());
+	if (written <= 0)
+		return;
+
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+
+	// another instance may be loading the same key, it sees the old binary or the whole new one
+	std::string cachePath = cacheDirectory + "/" + key + ".bin";
+	std::string temporaryPath = temporaryPathFor(cachePath);
+	std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "ERROR - SHADER: COULD NOT WRITE BINARY CACHE TO " << cacheDirectory << std::endl;
+		return;
+	}
+
+	file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	file.write(binary.data(), written);
+	file.close();
+	if (!file) {
+		std::filesystem::remove(temporaryPath, error);
+		std::cout << "ERROR - SHADER: COULD NOT WRITE BINARY CACHE TO " << cacheDirectory << std::endl;
+		return;
+	}
+
+	if (!replaceFile(temporaryPath, cachePath))
+		std::cout << "ERROR - SHADER: COULD NOT REPLACE BINARY CACHE " << cachePath << std::endl;
+}
+
+ShaderSource ShaderSource::fromFiles(const char* vertexPath, const char* fragmentPath)
+{
+	ShaderSource source;
+	source.name = std::string(vertexPath) + " + " + fragmentPath;
+
 	std::ifstream vShaderFile;
 	std::ifstream fShaderFile;
 
@@ -21,45 +292,43 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 		vShaderFile.close();
 		fShaderFile.close();
 
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		source.vertexCode = vShaderStream.str();
+		source.fragmentCode = fShaderStream.str();
 	}
-	catch (std::ifstream::failure e) {
-		std::cout << "ERROR - SHADER: FILE NOT SUCESSFULLY READ." << std::endl;
+	catch (const std::ifstream::failure&) {
+		std::cout << "ERROR - SHADER: FILE NOT SUCESSFULLY READ: " << source.name << std::endl;
 	}
 
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
+	return source;
+}
 
-	unsigned int vertex, fragment;
-	
-	vertex = compile(GL_VERTEX_SHADER, vShaderCode);
-	checkShader(GL_VERTEX_SHADER, vertex);
+ShaderSource ShaderSource::fromComputeFile(const char* computePath)
+{
+	ShaderSource source;
+	source.name = computePath;
 
-	fragment = compile(GL_FRAGMENT_SHADER, fShaderCode);
-	checkShader(GL_FRAGMENT_SHADER, fragment);
+	std::ifstream cShaderFile;
+	cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
+	try {
+		cShaderFile.open(computePath);
+		std::stringstream cShaderStream;
+		cShaderStream << cShaderFile.rdbuf();
+		cShaderFile.close();
 
-	int success;
-	char infoLog[512];
-	glGetProgramiv(ID, GL_LINK_STATUS, &success);
-	if (!success)
-	{
-		glGetProgramInfoLog(ID, 512, NULL, infoLog);
-		std::cout << "ERROR - SHADER: PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		source.computeCode = cShaderStream.str();
+	}
+	catch (const std::ifstream::failure&) {
+		std::cout << "ERROR - SHADER: FILE NOT SUCESSFULLY READ: " << source.name << std::endl;
 	}
 
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	return source;
 }
 
 void Shader::use()
 {
-	glUseProgram(ID);
+	wait();
+	glState.useProgram(ID);
 }
 
 unsigned int Shader::compile(int type, const char* source)
@@ -83,56 +352,384 @@ void Shader::checkShader(int type, unsigned int shaderID)
 		glGetShaderInfoLog(shaderID, 512, NULL, infoLog);
 		if (type == GL_VERTEX_SHADER)
 			std::cout << "ERROR - SHADER: VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		else if (type == GL_COMPUTE_SHADER)
+			std::cout << "ERROR - SHADER: COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
 		else
 			std::cout << "ERROR - SHADER: FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
 	};
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+static unsigned int uniformSize(GLenum type)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	switch (type) {
+	case GL_FLOAT:
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+	case GL_BOOL:
+		return 4;
+	case GL_FLOAT_VEC2:
+	case GL_INT_VEC2:
+	case GL_UNSIGNED_INT_VEC2:
+	case GL_BOOL_VEC2:
+		return 8;
+	case GL_FLOAT_VEC3:
+	case GL_INT_VEC3:
+	case GL_UNSIGNED_INT_VEC3:
+	case GL_BOOL_VEC3:
+		return 12;
+	case GL_FLOAT_VEC4:
+	case GL_INT_VEC4:
+	case GL_UNSIGNED_INT_VEC4:
+	case GL_BOOL_VEC4:
+	case GL_FLOAT_MAT2:
+		return 16;
+	case GL_FLOAT_MAT3:
+		return 36;
+	case GL_FLOAT_MAT4:
+		return 64;
+	default:
+		// samplers
+		return 4;
+	}
 }
 
-void Shader::setInt(const std::string& name, int value) const
+static int lowestSetBit(uint64_t value)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (int)index;
+#else
+	return __builtin_ctzll(value);
+#endif
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::loadUniforms()
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	unsigned int shadowSize = 0;
+	auto addSlot = [&](GLint location, GLenum type) {
+		slots.push_back({ location, type, shadowSize, uniformSize(type) });
+		shadowSize += uniformSize(type);
+		return (int)slots.size() - 1;
+	};
+
+	std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, i, maxLength, &length, &size, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), length);
+		GLint location = glGetUniformLocation(ID, name.c_str());
+		// members of uniform blocks have no location
+		if (location == -1)
+			continue;
+
+		int slot = addSlot(location, type);
+		uniforms.push_back({ name, slot });
+
+		// arrays are reported once as "name[0]", register the bare name and every element as well
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+			std::string base = name.substr(0, name.size() - 3);
+			uniforms.push_back({ base, slot });
+
+			for (GLint element = 1; element < size; element++) {
+				std::string elementName = base + "[" + std::to_string(element) + "]";
+				int elementSlot = addSlot(glGetUniformLocation(ID, elementName.c_str()), type);
+				uniforms.push_back({ elementName, elementSlot });
+			}
+		}
+	}
+
+	std::sort(uniforms.begin(), uniforms.end(), [](const UniformInfo& a, const UniformInfo& b) {
+		return a.name < b.name;
+	});
+
+	// the shadow starts from what the program holds, zero or the GLSL initializer, so a set() to the
+	// initial value is skipped and a set() to anything else is not
+	shadow.assign(shadowSize, 0);
+	dirty.assign((slots.size() + 63) / 64, 0);
+	for (const UniformSlot& slot : slots) {
+		void* value = &shadow[slot.offset];
+		switch (slot.type) {
+		case GL_FLOAT:
+		case GL_FLOAT_VEC2:
+		case GL_FLOAT_VEC3:
+		case GL_FLOAT_VEC4:
+		case GL_FLOAT_MAT2:
+		case GL_FLOAT_MAT3:
+		case GL_FLOAT_MAT4:
+			glGetUniformfv(ID, slot.location, static_cast<GLfloat*>(value));
+			break;
+		case GL_UNSIGNED_INT:
+		case GL_UNSIGNED_INT_VEC2:
+		case GL_UNSIGNED_INT_VEC3:
+		case GL_UNSIGNED_INT_VEC4:
+			glGetUniformuiv(ID, slot.location, static_cast<GLuint*>(value));
+			break;
+		default:
+			// ints, bools and samplers
+			glGetUniformiv(ID, slot.location, static_cast<GLint*>(value));
+			break;
+		}
+	}
 }
 
-void Shader::setFloat(const std::string& name, float value1, float value2) const
+void Shader::bindUniformBlocks()
 {
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), value1, value2);
+	GLuint frameIndex = glGetUniformBlockIndex(ID, "Frame");
+	if (frameIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, frameIndex, FRAME_BINDING);
+
+	GLuint lightsIndex = glGetUniformBlockIndex(ID, "Lights");
+	if (lightsIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, lightsIndex, LIGHTS_BINDING);
 }
 
-void Shader::setFloat(const std::string& name, float value1, float value2, float value3) const
+int Shader::findSlot(const std::string& name)
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), value1, value2, value3);
+	wait();
+
+	auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name, [](const UniformInfo& info, const std::string& value) {
+		return info.name < value;
+	});
+
+	if (it == uniforms.end() || it->name != name)
+		return -1;
+
+	return it->slot;
 }
 
-void Shader::setFloat(const std::string& name, glm::vec3 value) const
+GLint Shader::getUniformLocation(const std::string& name)
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z);
+	int slot = findSlot(name);
+	return slot == -1 ? -1 : slots[slot].location;
 }
 
-void Shader::setFloat(const std::string& name, float value1, float value2, float value3, float value4) const
+// ---------------------------------------------------------------------------------------------- Uniform Shadow
+template <typename T>
+void Shader::store(int slot, const T& value)
 {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), value1, value2, value3, value4);
+	if (slot < 0)
+		return;
+
+	const UniformSlot& target = slots[slot];
+	unsigned int size = sizeof(T) < target.size ? sizeof(T) : target.size;
+	unsigned char* stored = &shadow[target.offset];
+	if (memcmp(stored, &value, size) == 0)
+		return;
+
+	memcpy(stored, &value, size);
+	dirty[slot / 64] |= 1ull << (slot % 64);
+	hasDirty = true;
 }
 
-void Shader::setMat(const std::string& name, glm::mat4 value) const
+void Shader::flush()
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	// the draw after this uses whatever program is bound, even when there is nothing to upload
+	use();
+	if (!hasDirty)
+		return;
+
+	for (size_t word = 0; word < dirty.size(); word++) {
+		uint64_t bits = dirty[word];
+		while (bits) {
+			int bit = lowestSetBit(bits);
+			bits &= bits - 1;
+
+			const UniformSlot& slot = slots[word * 64 + bit];
+			const void* data = &shadow[slot.offset];
+			const GLfloat* floats = static_cast<const GLfloat*>(data);
+			const GLint* ints = static_cast<const GLint*>(data);
+			const GLuint* uints = static_cast<const GLuint*>(data);
+
+			switch (slot.type) {
+			case GL_FLOAT:			glUniform1fv(slot.location, 1, floats); break;
+			case GL_FLOAT_VEC2:		glUniform2fv(slot.location, 1, floats); break;
+			case GL_FLOAT_VEC3:		glUniform3fv(slot.location, 1, floats); break;
+			case GL_FLOAT_VEC4:		glUniform4fv(slot.location, 1, floats); break;
+			case GL_FLOAT_MAT2:		glUniformMatrix2fv(slot.location, 1, GL_FALSE, floats); break;
+			case GL_FLOAT_MAT3:		glUniformMatrix3fv(slot.location, 1, GL_FALSE, floats); break;
+			case GL_FLOAT_MAT4:		glUniformMatrix4fv(slot.location, 1, GL_FALSE, floats); break;
+			case GL_INT_VEC2:
+			case GL_BOOL_VEC2:		glUniform2iv(slot.location, 1, ints); break;
+			case GL_INT_VEC3:
+			case GL_BOOL_VEC3:		glUniform3iv(slot.location, 1, ints); break;
+			case GL_INT_VEC4:
+			case GL_BOOL_VEC4:		glUniform4iv(slot.location, 1, ints); break;
+			case GL_UNSIGNED_INT:		glUniform1uiv(slot.location, 1, uints); break;
+			case GL_UNSIGNED_INT_VEC2:	glUniform2uiv(slot.location, 1, uints); break;
+			case GL_UNSIGNED_INT_VEC3:	glUniform3uiv(slot.location, 1, uints); break;
+			case GL_UNSIGNED_INT_VEC4:	glUniform4uiv(slot.location, 1, uints); break;
+			default:				glUniform1iv(slot.location, 1, ints); break;
+			}
+		}
+		dirty[word] = 0;
+	}
+
+	hasDirty = false;
+}
+
+void Shader::set(UniformHandle<bool> handle, bool value)
+{
+	store(handle.slot, (int)value);
+}
+
+void Shader::set(UniformHandle<int> handle, int value)
+{
+	store(handle.slot, value);
+}
+
+void Shader::set(UniformHandle<float> handle, float value)
+{
+	store(handle.slot, value);
+}
+
+void Shader::set(UniformHandle<glm::vec2> handle, const glm::vec2& value)
+{
+	store(handle.slot, value);
+}
+
+void Shader::set(UniformHandle<glm::vec3> handle, const glm::vec3& value)
+{
+	store(handle.slot, value);
+}
+
+void Shader::set(UniformHandle<glm::vec4> handle, const glm::vec4& value)
+{
+	store(handle.slot, value);
+}
+
+void Shader::set(UniformHandle<glm::mat3> handle, const glm::mat3& value)
+{
+	store(handle.slot, value);
+}
+
+void Shader::set(UniformHandle<glm::mat4> handle, const glm::mat4& value)
+{
+	store(handle.slot, value);
+}
+
+void Shader::setBool(const std::string& name, bool value)
+{
+	store(findSlot(name), (int)value);
+}
+
+void Shader::setInt(const std::string& name, int value)
+{
+	store(findSlot(name), value);
+}
+
+void Shader::setFloat(const std::string& name, float value)
+{
+	store(findSlot(name), value);
+}
+
+void Shader::setFloat(const std::string& name, float value1, float value2)
+{
+	store(findSlot(name), glm::vec2(value1, value2));
+}
+
+void Shader::setFloat(const std::string& name, float value1, float value2, float value3)
+{
+	store(findSlot(name), glm::vec3(value1, value2, value3));
+}
+
+void Shader::setFloat(const std::string& name, glm::vec3 value)
+{
+	store(findSlot(name), value);
+}
+
+void Shader::setFloat(const std::string& name, float value1, float value2, float value3, float value4)
+{
+	store(findSlot(name), glm::vec4(value1, value2, value3, value4));
+}
+
+void Shader::setMat(const std::string& name, glm::mat4 value)
+{
+	store(findSlot(name), value);
 }
 
 float Shader::getFloat(const std::string& name)
 {
-	GLint uniformLocation = glGetUniformLocation(ID, name.c_str());
+	int slot = findSlot(name);
+	if (slot == -1)
+		return 0.0f;
+
 	float value;
-	glGetUniformfv(ID, uniformLocation, &value);
+	memcpy(&value, &shadow[slots[slot].offset], sizeof(float));
 
 	return value;
 }
+
+// ---------------------------------------------------------------------------------------------- Variants
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath)
+	: source(ShaderSource::fromFiles(vertexPath, fragmentPath))
+{
+}
+
+Shader& ShaderVariants::get(const ShaderDefines& defines)
+{
+	std::string key = variantKey(defines);
+
+	auto it = variants.find(key);
+	if (it != variants.end())
+		return *it->second;
+
+	std::unique_ptr<Shader>& variant = variants[key];
+	variant.reset(new Shader(source, defines));
+
+	return *variant;
+}
+
+std::string ShaderVariants::variantKey(const ShaderDefines& defines)
+{
+	// order of the defines does not matter for the compiled program
+	ShaderDefines sorted = defines;
+	std::sort(sorted.begin(), sorted.end());
+
+	std::string key;
+	for (const auto& define : sorted)
+		key += define.first + "=" + define.second + ";";
+
+	return key;
+}
+
+// ---------------------------------------------------------------------------------------------- Warm-up
+void ShaderWarmup::add(Shader& shader)
+{
+	pending.push_back(&shader);
+}
+
+bool ShaderWarmup::poll()
+{
+	for (size_t i = 0; i < pending.size();) {
+		if (pending[i]->isReady()) {
+			pending[i]->warmUp();
+			pending[i] = pending.back();
+			pending.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+
+	return pending.empty();
+}
+
+void ShaderWarmup::wait()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	while (!poll())
+		std::this_thread::yield();
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "SHADER: warm-up finished after " << milliseconds << " ms" << std::endl;
+}
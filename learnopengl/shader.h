@@ -5,36 +5,173 @@
 #include <glad/glad.h>
 
 #include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <utility>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Pre-resolved uniform. Resolve once with Shader::uniform<T>(name) and pass it to Shader::set
+// every frame instead of the uniform name.
+template <typename T>
+struct UniformHandle {
+	int slot = -1;
+
+	bool isValid() const { return slot != -1; }
+};
+
+// One uniform value on the GL side, and where its shadow copy lives.
+struct UniformSlot {
+	GLint location;
+	GLenum type;
+	unsigned int offset;
+	unsigned int size;
+};
+
+struct UniformInfo {
+	std::string name;
+	int slot;
+};
+
+// Preprocessor defines injected right after the #version line, e.g. { { "FLIP_UV", "" }, { "NR_POINT_LIGHTS", "1" } }.
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+// Either a vertex/fragment pair or a compute shader on its own.
+struct ShaderSource {
+	std::string name;
+	std::string vertexCode;
+	std::string fragmentCode;
+	std::string computeCode;
+
+	static ShaderSource fromFiles(const char* vertexPath, const char* fragmentPath);
+	// Needs GLEXT_ARB_compute_shader.
+	static ShaderSource fromComputeFile(const char* computePath);
+};
+
 class Shader {
 public:
+	// Linked program binaries are stored here, keyed by a hash of the sources and the driver.
+	static std::string cacheDirectory;
+
 	unsigned int ID;
+	std::string name;
 
-	Shader(const char* vertexPath, const char* fragmentPath);
+	Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines());
+	// Construction only submits the compile and link. The program is finished (status checks,
+	// binary cache write, uniform table) by isReady() once the driver is done, or by the first
+	// call that needs it, which then blocks.
+	Shader(const ShaderSource& source, const ShaderDefines& defines = ShaderDefines());
 	void use();
-	
-	void setBool(const std::string &name, bool value) const;
-	
-	void setInt(const std::string& name, int value) const;
-	
-	void setFloat(const std::string& name, float value) const;
-	void setFloat(const std::string& name, float value1, float value2) const;
-	void setFloat(const std::string& name, float value1, float value2, float value3) const;
-	void setFloat(const std::string& name, glm::vec3 value) const;
-	void setFloat(const std::string& name, float value1, float value2, float value3, float value4) const;
-	
-	void setMat(const std::string& name, glm::mat4 value) const;
+
+	// Non-blocking when GL_KHR_parallel_shader_compile is available.
+	bool isReady();
+	void wait();
+	// Issues a masked-off draw so the driver finishes any deferred work before the first real frame.
+	void warmUp();
+
+	template <typename T>
+	UniformHandle<T> uniform(const std::string& name) {
+		return UniformHandle<T>{ findSlot(name) };
+	}
+
+	// Looks the name up in the table built at link time; inactive uniforms return -1.
+	GLint getUniformLocation(const std::string& name);
+
+	// Setters only update a CPU shadow copy and mark the uniform dirty when the value changed.
+	// flush() binds the program, uploads the dirty ones and has to run before every draw with it.
+	void set(UniformHandle<bool> handle, bool value);
+	void set(UniformHandle<int> handle, int value);
+	void set(UniformHandle<float> handle, float value);
+	void set(UniformHandle<glm::vec2> handle, const glm::vec2& value);
+	void set(UniformHandle<glm::vec3> handle, const glm::vec3& value);
+	void set(UniformHandle<glm::vec4> handle, const glm::vec4& value);
+	void set(UniformHandle<glm::mat3> handle, const glm::mat3& value);
+	void set(UniformHandle<glm::mat4> handle, const glm::mat4& value);
+
+	void setBool(const std::string &name, bool value);
+
+	void setInt(const std::string& name, int value);
+
+	void setFloat(const std::string& name, float value);
+	void setFloat(const std::string& name, float value1, float value2);
+	void setFloat(const std::string& name, float value1, float value2, float value3);
+	void setFloat(const std::string& name, glm::vec3 value);
+	void setFloat(const std::string& name, float value1, float value2, float value3, float value4);
+
+	void setMat(const std::string& name, glm::mat4 value);
 
 	float getFloat(const std::string& name);
 
+	void flush();
+
 private:
+	bool ready = false;
+	bool cacheHit = false;
+	unsigned int pendingVertex = 0;
+	unsigned int pendingFragment = 0;
+	unsigned int pendingCompute = 0;
+	std::string binaryKey;
+	std::chrono::steady_clock::time_point submitTime;
+
+	// Every active uniform (and every element of uniform arrays), sorted by name.
+	std::vector<UniformInfo> uniforms;
+	std::vector<UniformSlot> slots;
+	std::vector<unsigned char> shadow;
+	// one bit per slot
+	std::vector<uint64_t> dirty;
+	bool hasDirty = false;
+
+	static std::string injectDefines(const std::string& code, const ShaderDefines& defines);
+	static std::string cacheKey(const std::string& vertexCode, const std::string& fragmentCode);
+
+	bool loadBinary(const std::string& key);
+	void saveBinary(const std::string& key) const;
+	void link(const std::string& vertexCode, const std::string& fragmentCode);
+	void linkCompute(const std::string& computeCode);
 	unsigned int compile(int type, const char* source);
 	void checkShader(int type, unsigned int shaderID);
+	void finish();
+	void bindUniformBlocks();
+	void loadUniforms();
+	int findSlot(const std::string& name);
+
+	template <typename T>
+	void store(int slot, const T& value);
+};
+
+// Loading helper. Programs are submitted as they are constructed and finished here as the
+// driver completes them, so compiles run on the driver's threads instead of back to back.
+class ShaderWarmup {
+public:
+	void add(Shader& shader);
+
+	// Finishes and warms up every program whose compile completed, true once none are left.
+	bool poll();
+	void wait();
+
+private:
+	std::vector<Shader*> pending;
+};
+
+// Permutations of one vertex/fragment pair. Each set of defines is compiled the first time it is
+// requested and cached, so objects only pay for the features they use.
+class ShaderVariants {
+public:
+	ShaderVariants(const char* vertexPath, const char* fragmentPath);
+
+	Shader& get(const ShaderDefines& defines = ShaderDefines());
+
+private:
+	ShaderSource source;
+	std::map<std::string, std::unique_ptr<Shader>> variants;
+
+	static std::string variantKey(const ShaderDefines& defines);
 };
 
 #endif // SHADER_H
\ No newline at end of file
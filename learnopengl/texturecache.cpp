@@ -0,0 +1,371 @@
+#include "texturecache.h"
+#include "glextensions.h"
+#include "glstate.h"
+#include "hash.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+std::string TextureCache::cacheDirectory = "texturecache";
+bool TextureCache::compress = false;
+
+static_assert(sizeof(TextureCacheHeader) == 40, "TextureCacheHeader layout changed, bump TEXTURE_CACHE_VERSION");
+static_assert(sizeof(TextureCacheLevel) == 24, "TextureCacheLevel layout changed, bump TEXTURE_CACHE_VERSION");
+
+size_t TextureImage::byteSize() const
+{
+	size_t total = 0;
+	for (const TextureLevel& level : levels)
+		total += level.size;
+
+	return total;
+}
+
+std::string TextureCache::pathFor(const std::string& sourcePath)
+{
+	return cacheDirectory + "/" + hashToHex(hashString(sourcePath)) + ".tex";
+}
+
+static TextureEncoding encodingFor(int components, bool compressible)
+{
+	// BC1 has no useful alpha, so only opaque RGB textures are compressed
+	return TextureCache::compress && compressible && components == 3 ? TEXTURE_BC1 : TEXTURE_RAW;
+}
+
+static size_t levelSize(TextureEncoding encoding, int width, int height, int components)
+{
+	if (encoding == TEXTURE_BC1)
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+
+	return (size_t)width * height * components;
+}
+
+// ---------------------------------------------------------------------------------------------- Mip Chain
+// 2x2 box filter. Odd sizes repeat the last row or column instead of reading past the edge.
+static void downsample(const unsigned char* source, int width, int height, int components, unsigned char* target, int targetWidth, int targetHeight)
+{
+	for (int y = 0; y < targetHeight; y++) {
+		const unsigned char* row0 = source + (size_t)std::min(2 * y, height - 1) * width * components;
+		const unsigned char* row1 = source + (size_t)std::min(2 * y + 1, height - 1) * width * components;
+
+		for (int x = 0; x < targetWidth; x++) {
+			int x0 = std::min(2 * x, width - 1) * components;
+			int x1 = std::min(2 * x + 1, width - 1) * components;
+
+			for (int c = 0; c < components; c++)
+				*target++ = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- BC1
+static uint16_t packColor(const unsigned char* rgb)
+{
+	return (uint16_t)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
+
+static void unpackColor(uint16_t color, int* rgb)
+{
+	rgb[0] = ((color >> 11) & 31) * 255 / 31;
+	rgb[1] = ((color >> 5) & 63) * 255 / 63;
+	rgb[2] = (color & 31) * 255 / 31;
+}
+
+// Endpoints from the bounding box of the block's colours, then every pixel takes the nearest of the
+// four palette entries. Fast and good enough for diffuse and specular maps.
+static void encodeBlock(const unsigned char* pixels, unsigned char* block)
+{
+	unsigned char low[3] = { 255, 255, 255 };
+	unsigned char high[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			low[c] = std::min(low[c], pixels[i * 3 + c]);
+			high[c] = std::max(high[c], pixels[i * 3 + c]);
+		}
+	}
+
+	uint16_t color0 = packColor(high);
+	uint16_t color1 = packColor(low);
+	uint32_t indices = 0;
+
+	if (color0 != color1) {
+		// color0 > color1 selects the four colour mode
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		int palette[4][3];
+		unpackColor(color0, palette[0]);
+		unpackColor(color1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			int bestDistance = INT32_MAX;
+			for (int p = 0; p < 4; p++) {
+				int distance = 0;
+				for (int c = 0; c < 3; c++) {
+					int difference = pixels[i * 3 + c] - palette[p][c];
+					distance += difference * difference;
+				}
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= (uint32_t)best << (i * 2);
+		}
+	}
+
+	block[0] = (unsigned char)(color0 & 0xFF);
+	block[1] = (unsigned char)(color0 >> 8);
+	block[2] = (unsigned char)(color1 & 0xFF);
+	block[3] = (unsigned char)(color1 >> 8);
+	std::memcpy(block + 4, &indices, 4);
+}
+
+static void compressLevel(const unsigned char* rgb, int width, int height, unsigned char* target)
+{
+	unsigned char pixels[16 * 3];
+	for (int blockY = 0; blockY < height; blockY += 4) {
+		for (int blockX = 0; blockX < width; blockX += 4) {
+			// blocks hanging over the edge repeat the last row or column
+			for (int y = 0; y < 4; y++) {
+				for (int x = 0; x < 4; x++) {
+					const unsigned char* source = rgb + ((size_t)std::min(blockY + y, height - 1) * width + std::min(blockX + x, width - 1)) * 3;
+					std::memcpy(pixels + (y * 4 + x) * 3, source, 3);
+				}
+			}
+			encodeBlock(pixels, target);
+			target += 8;
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- Cook
+static bool cook(const unsigned char* fileBytes, size_t fileSize, bool compressible, TextureImage& image)
+{
+	// the flip flag is per thread, so decodes on different workers cannot race on it
+	stbi_set_flip_vertically_on_load_thread(1);
+	int width, height, components;
+	unsigned char* pixels = stbi_load_from_memory(fileBytes, (int)fileSize, &width, &height, &components, 0);
+	if (!pixels)
+		return false;
+
+	image.width = width;
+	image.height = height;
+	image.components = components;
+	image.encoding = encodingFor(components, compressible);
+
+	// every raw level first, then the compressed copies after them when needed
+	std::vector<std::pair<int, int>> sizes;
+	for (int w = width, h = height; ; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+		sizes.push_back({ w, h });
+		if (w == 1 && h == 1)
+			break;
+	}
+
+	std::vector<unsigned char> raw;
+	std::vector<size_t> rawOffsets;
+	for (const std::pair<int, int>& size : sizes) {
+		rawOffsets.push_back(raw.size());
+		raw.resize(raw.size() + levelSize(TEXTURE_RAW, size.first, size.second, components));
+	}
+
+	std::memcpy(raw.data(), pixels, (size_t)width * height * components);
+	stbi_image_free(pixels);
+	for (size_t i = 1; i < sizes.size(); i++)
+		downsample(raw.data() + rawOffsets[i - 1], sizes[i - 1].first, sizes[i - 1].second, components, raw.data() + rawOffsets[i], sizes[i].first, sizes[i].second);
+
+	if (image.encoding == TEXTURE_BC1) {
+		size_t total = 0;
+		for (const std::pair<int, int>& size : sizes)
+			total += levelSize(TEXTURE_BC1, size.first, size.second, components);
+		image.storage.resize(total);
+
+		size_t offset = 0;
+		for (size_t i = 0; i < sizes.size(); i++) {
+			compressLevel(raw.data() + rawOffsets[i], sizes[i].first, sizes[i].second, image.storage.data() + offset);
+			offset += levelSize(TEXTURE_BC1, sizes[i].first, sizes[i].second, components);
+		}
+	}
+	else {
+		image.storage = std::move(raw);
+	}
+
+	size_t offset = 0;
+	for (const std::pair<int, int>& size : sizes) {
+		size_t bytes = levelSize(image.encoding, size.first, size.second, components);
+		image.levels.push_back({ image.storage.data() + offset, bytes, size.first, size.second });
+		offset += bytes;
+	}
+
+	return true;
+}
+
+static void writeCache(const std::string& cachePath, uint64_t sourceHash, const TextureImage& image)
+{
+	TextureCacheHeader header;
+	std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.width = image.width;
+	header.height = image.height;
+	header.components = image.components;
+	header.encoding = image.encoding;
+	header.levelCount = (uint32_t)image.levels.size();
+	header.padding = 0;
+
+	std::vector<TextureCacheLevel> table(image.levels.size());
+	uint64_t offset = sizeof(TextureCacheHeader) + table.size() * sizeof(TextureCacheLevel);
+	for (size_t i = 0; i < table.size(); i++) {
+		offset = (offset + 15) & ~(uint64_t)15;
+		table[i] = { offset, image.levels[i].size, (uint32_t)image.levels[i].width, (uint32_t)image.levels[i].height };
+		offset += image.levels[i].size;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+
+	// another worker may have the old file mapped, it is replaced whole once the new one is written
+	std::string temporaryPath = temporaryPathFor(cachePath);
+	std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "ERROR - TEXTURECACHE: COULD NOT WRITE " << cachePath << std::endl;
+		return;
+	}
+
+	const char zeros[16] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(TextureCacheLevel));
+	for (size_t i = 0; i < table.size(); i++) {
+		file.write(zeros, (std::streamsize)(table[i].offset - (uint64_t)file.tellp()));
+		file.write(reinterpret_cast<const char*>(image.levels[i].data), image.levels[i].size);
+	}
+
+	file.close();
+	if (!file) {
+		std::filesystem::remove(temporaryPath, error);
+		std::cout << "ERROR - TEXTURECACHE: COULD NOT WRITE " << cachePath << std::endl;
+		return;
+	}
+	replaceFile(temporaryPath, cachePath);
+}
+
+static bool readCache(const std::string& cachePath, uint64_t sourceHash, bool compressible, TextureImage& image)
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->open(cachePath) || file->size() < sizeof(TextureCacheHeader))
+		return false;
+
+	TextureCacheHeader header;
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, 4) != 0 || header.version != TEXTURE_CACHE_VERSION
+		|| header.sourceHash != sourceHash || header.components < 1 || header.components > 4
+		|| header.width == 0 || header.height == 0
+		|| header.encoding != (uint32_t)encodingFor(header.components, compressible))
+		return false;
+
+	size_t size = file->size();
+	uint64_t tableEnd = sizeof(TextureCacheHeader) + (uint64_t)header.levelCount * sizeof(TextureCacheLevel);
+	if (header.levelCount == 0 || tableEnd > size)
+		return false;
+
+	image.width = header.width;
+	image.height = header.height;
+	image.components = header.components;
+	image.encoding = (TextureEncoding)header.encoding;
+
+	// the chain the cook writes: every level half the one before, down to exactly one 1x1 level
+	uint32_t width = header.width, height = header.height;
+	for (uint32_t i = 0; i < header.levelCount; i++) {
+		TextureCacheLevel level;
+		std::memcpy(&level, file->data() + sizeof(TextureCacheHeader) + i * sizeof(TextureCacheLevel), sizeof(level));
+		bool last = i + 1 == header.levelCount;
+		if (level.width != width || level.height != height || last != (width == 1 && height == 1)
+			|| level.offset > size || level.size > size - level.offset
+			|| level.size != levelSize(image.encoding, level.width, level.height, image.components)) {
+			image.levels.clear();
+			return false;
+		}
+		image.levels.push_back({ file->data() + level.offset, (size_t)level.size, (int)level.width, (int)level.height });
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+
+	image.mapping = file;
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------- Load
+TextureImage decodeTexture(const std::string& filename, bool compressible)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	TextureImage image;
+
+	MappedFile source;
+	if (!source.open(filename))
+		return image;
+
+	uint64_t sourceHash = hashBytes(source.data(), source.size());
+	std::string cachePath = TextureCache::pathFor(filename);
+
+	image.cacheHit = readCache(cachePath, sourceHash, compressible, image);
+	if (!image.cacheHit && cook(source.data(), source.size(), compressible, image))
+		writeCache(cachePath, sourceHash, image);
+
+	image.decodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return image;
+}
+
+unsigned int uploadTexture(TextureImage& image, const char* path)
+{
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+
+	if (image.levels.empty()) {
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return textureID;
+	}
+
+	GLenum format = GL_RGBA;
+	if (image.components == 1)
+		format = GL_RED;
+	else if (image.components == 2)
+		format = GL_RG;
+	else if (image.components == 3)
+		format = GL_RGB;
+
+	glState.bindTexture(0, GL_TEXTURE_2D, textureID);
+
+	// small levels of RGB textures have rows that are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < image.levels.size(); i++) {
+		const TextureLevel& level = image.levels[i];
+		if (image.encoding == TEXTURE_BC1)
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, level.width, level.height, 0, (GLsizei)level.size, level.data);
+		else
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, level.data);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// the driver has its own copy now
+	image.levels.clear();
+	image.mapping.reset();
+	std::vector<unsigned char>().swap(image.storage);
+
+	return textureID;
+}
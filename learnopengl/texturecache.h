@@ -0,0 +1,95 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include "mappedfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------------------------------------------- File Layout
+// header | level table | level blobs (16 byte aligned), largest level first, down to 1x1.
+// Levels are either tightly packed 8 bit pixels with the source's channel count, or BC1 blocks.
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+const char TEXTURE_CACHE_MAGIC[4] = { 'L', 'T', 'E', 'X' };
+
+enum TextureEncoding {
+	TEXTURE_RAW = 0,
+	TEXTURE_BC1 = 1
+};
+
+struct TextureCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t width;
+	uint32_t height;
+	uint32_t components;
+	uint32_t encoding;
+	uint32_t levelCount;
+	uint32_t padding;
+};
+
+struct TextureCacheLevel {
+	uint64_t offset;
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+// ---------------------------------------------------------------------------------------------- Image
+struct TextureLevel {
+	const unsigned char* data;
+	size_t size;
+	int width;
+	int height;
+};
+
+// A texture ready to upload, with its whole mip chain. The levels point either into the mapped
+// cache file or into storage, both owned here.
+struct TextureImage {
+	TextureImage() {}
+	// levels point into storage, so the image can be moved but not copied
+	TextureImage(TextureImage&&) = default;
+	TextureImage& operator=(TextureImage&&) = default;
+	TextureImage(const TextureImage&) = delete;
+	TextureImage& operator=(const TextureImage&) = delete;
+
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	TextureEncoding encoding = TEXTURE_RAW;
+	std::vector<TextureLevel> levels;
+
+	// where the levels came from and what producing them cost, for the load report
+	bool cacheHit = false;
+	double decodeMilliseconds = 0.0;
+
+	std::shared_ptr<MappedFile> mapping;
+	std::vector<unsigned char> storage;
+
+	size_t byteSize() const;
+};
+
+// ---------------------------------------------------------------------------------------------- Cache
+// Cooked textures, one file per source path. A file is only used when the source content hash and
+// the encoding it was cooked with still match.
+class TextureCache {
+public:
+	static std::string cacheDirectory;
+	// Cook RGB textures to BC1. Set from the GL thread before loading, only when the driver supports S3TC.
+	static bool compress;
+
+	static std::string pathFor(const std::string& sourcePath);
+};
+
+// Maps the cooked texture when the cache is valid, otherwise decodes the source, builds the mip chain,
+// and writes the cache. Touches no GL state, so it runs on the worker pool. Textures that are not
+// compressible (normal maps, alpha) are never block compressed.
+TextureImage decodeTexture(const std::string& filename, bool compressible = true);
+// Uploads every level as it is, without glGenerateMipmap. Needs the GL thread.
+unsigned int uploadTexture(TextureImage& image, const char* path);
+
+#endif //TEXTURECACHE_H
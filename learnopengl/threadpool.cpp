@@ -0,0 +1,90 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+	if (count == 0)
+		return;
+
+	// every participant pulls the next index until none are left, so uneven items balance out.
+	// The caller only waits for the items to finish, not for the helpers to start, so this also
+	// works from inside a pool task when every worker is busy.
+	struct Shared {
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		size_t count;
+		std::function<void(size_t)> body;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+	shared->count = count;
+	shared->body = body;
+
+	auto run = [shared] {
+		for (size_t i = shared->next++; i < shared->count; i = shared->next++) {
+			shared->body(i);
+			if (++shared->done == shared->count) {
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				shared->finished.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min(workers.size(), count - 1);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < helpers; i++)
+			tasks.push(run);
+	}
+	wake.notify_all();
+
+	run();
+
+	std::unique_lock<std::mutex> lock(shared->mutex);
+	shared->finished.wait(lock, [&] { return shared->done == shared->count; });
+}
+
+ThreadPool& workerPool()
+{
+	// at least one worker, submitted tasks would never run otherwise
+	static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
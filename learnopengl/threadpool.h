@@ -0,0 +1,59 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from one queue. Nothing submitted here may call OpenGL,
+// the context belongs to the main thread.
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template<typename F>
+	auto submit(F task) -> std::future<decltype(task())>
+	{
+		typedef decltype(task()) Result;
+		std::shared_ptr<std::packaged_task<Result()>> packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+		std::future<Result> result = packaged->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push([packaged] { (*packaged)(); });
+		}
+		wake.notify_one();
+
+		return result;
+	}
+
+	// Calls body(i) for every i in [0, count) spread over the workers and the calling thread, and
+	// returns once all of them have finished.
+	void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+	size_t size() const { return workers.size(); }
+
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void workerLoop();
+};
+
+// Pool shared by the engine, one worker per hardware thread besides the main one (at least one).
+// Created on first use.
+ThreadPool& workerPool();
+
+#endif //THREADPOOL_H
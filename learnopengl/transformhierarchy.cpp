@@ -0,0 +1,79 @@
+#include "transformhierarchy.h"
+
+#include <algorithm>
+#include <cstring>
+
+void TransformHierarchy::clear()
+{
+	parents.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	names.clear();
+	firstDirty = 0;
+}
+
+void TransformHierarchy::reserve(size_t count)
+{
+	parents.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	dirty.reserve(count);
+	names.reserve(count);
+}
+
+int TransformHierarchy::add(int parent, const glm::mat4& local, const std::string& name)
+{
+	int node = (int)parents.size();
+	if (parent >= node)
+		parent = ROOT;
+
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	names.push_back(name);
+	firstDirty = std::min(firstDirty, (size_t)node);
+	return node;
+}
+
+void TransformHierarchy::setLocal(int node, const glm::mat4& local)
+{
+	locals[node] = local;
+	dirty[node] = 1;
+	firstDirty = std::min(firstDirty, (size_t)node);
+}
+
+size_t TransformHierarchy::update()
+{
+	size_t count = parents.size();
+	if (firstDirty >= count)
+		return 0;
+
+	// a node is recomputed when it was set or its parent was recomputed earlier in this pass. The
+	// flags stay up until the pass is over so children further down can still see them.
+	size_t updated = 0;
+	for (size_t i = firstDirty; i < count; i++) {
+		int parent = parents[i];
+		if (parent != ROOT)
+			dirty[i] |= dirty[parent];
+		if (!dirty[i])
+			continue;
+
+		worlds[i] = parent != ROOT ? worlds[parent] * locals[i] : locals[i];
+		updated++;
+	}
+
+	std::memset(&dirty[firstDirty], 0, count - firstDirty);
+	firstDirty = count;
+	return updated;
+}
+
+int TransformHierarchy::find(const std::string& name) const
+{
+	for (size_t i = 0; i < names.size(); i++) {
+		if (names[i] == name)
+			return (int)i;
+	}
+	return -1;
+}
@@ -0,0 +1,48 @@
+#ifndef TRANSFORMHIERARCHY_H
+#define TRANSFORMHIERARCHY_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Node transforms stored as separate arrays with every parent before its children, so one forward
+// pass updates the whole tree. Setting a local matrix only flags the node; update() recomputes the
+// world matrices of flagged nodes and everything below them and leaves the rest alone.
+class TransformHierarchy {
+public:
+	// parent of top-level nodes
+	static const int ROOT = -1;
+
+	void clear();
+	void reserve(size_t count);
+
+	// Appends a node under parent, which is ROOT or an earlier node. Returns its index.
+	int add(int parent, const glm::mat4& local, const std::string& name = std::string());
+	void setLocal(int node, const glm::mat4& local);
+
+	// Brings every world matrix up to date. Returns how many were recomputed, 0 when nothing changed.
+	size_t update();
+	bool isDirty() const { return firstDirty < parents.size(); }
+
+	size_t size() const { return parents.size(); }
+	int getParent(int node) const { return parents[node]; }
+	const glm::mat4& getLocal(int node) const { return locals[node]; }
+	// Only current after update().
+	const glm::mat4& getWorld(int node) const { return worlds[node]; }
+	const std::string& getName(int node) const { return names[node]; }
+	// First node with this name, -1 when there is none.
+	int find(const std::string& name) const;
+
+private:
+	std::vector<int> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<uint8_t> dirty;
+	std::vector<std::string> names;
+	// no node before this one is dirty, size() when none is
+	size_t firstDirty = 0;
+};
+
+#endif //TRANSFORMHIERARCHY_H
@@ -0,0 +1,18 @@
+#include "uniformbuffer.h"
+#include "glstate.h"
+
+UniformBuffer::UniformBuffer(unsigned int binding, size_t size)
+	: binding(binding)
+{
+	glGenBuffers(1, &ID);
+	glState.bindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+
+	glState.bindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+}
+
+void UniformBuffer::update(const void* data, size_t size, size_t offset)
+{
+	glState.bindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
@@ -0,0 +1,94 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// ---------------------------------------------------------------------------------------------- Binding Points
+// Every program gets its Frame and Lights blocks bound to these points at link time.
+enum UniformBinding {
+	FRAME_BINDING	= 0,
+	LIGHTS_BINDING	= 1
+};
+
+const int MAX_POINT_LIGHTS	= 4;
+const int MAX_SPOT_LIGHTS	= 4;
+
+// ---------------------------------------------------------------------------------------------- std140 Blocks
+// These mirror the Frame and Lights blocks declared in the shaders. Under std140 a vec3 takes
+// 16 bytes unless a scalar follows it, so the members are ordered to fill those gaps.
+struct FrameBlock {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 viewPos;
+	float padding;
+	glm::mat4 viewProjection;	// projection * view, so shaders never multiply them per vertex
+};
+
+struct DirLightBlock {
+	glm::vec3 direction;
+	float padding0;
+	glm::vec3 ambient;
+	float padding1;
+	glm::vec3 diffuse;
+	float padding2;
+	glm::vec3 specular;
+	float padding3;
+};
+
+struct PointLightBlock {
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float padding;
+};
+
+struct SpotLightBlock {
+	glm::vec3 position;
+	float innerCutoff;
+	glm::vec3 direction;
+	float outerCutoff;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+};
+
+struct LightsBlock {
+	DirLightBlock dirLight;
+	PointLightBlock pointLights[MAX_POINT_LIGHTS];
+	SpotLightBlock spotLights[MAX_SPOT_LIGHTS];
+	int numPointLights;
+	int numSpotLights;
+	int padding[2];
+};
+
+static_assert(sizeof(FrameBlock) == 208, "FrameBlock does not match the std140 Frame block");
+static_assert(sizeof(LightsBlock) == 656, "LightsBlock does not match the std140 Lights block");
+
+// ----------------------------------------------------------------------------------------------
+class UniformBuffer {
+public:
+	unsigned int ID;
+	unsigned int binding;
+
+	UniformBuffer(unsigned int binding, size_t size);
+
+	// Uploads the whole block with a single glBufferSubData.
+	void update(const void* data, size_t size, size_t offset = 0);
+
+	template <typename T>
+	void update(const T& block) {
+		update(&block, sizeof(T));
+	}
+};
+
+#endif //UNIFORMBUFFER_H
@@ -0,0 +1,48 @@
+#include "vertexformat.h"
+#include "mesh.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex has to stay 16 bytes, the attribute offsets in Mesh::setupMesh assume it");
+
+glm::mat4 dequantizationMatrix(const AABB& bounds)
+{
+	if (bounds.isEmpty())
+		return glm::mat4(1.0f);
+
+	glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+	return glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), size);
+}
+
+void packVertices(const Vertex* vertices, size_t count, const AABB& bounds, PackedVertex* packed)
+{
+	glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+
+	for (size_t i = 0; i < count; i++) {
+		const Vertex& vertex = vertices[i];
+		PackedVertex& out = packed[i];
+
+		glm::vec3 unit = glm::clamp((vertex.Position - bounds.min) / size, 0.0f, 1.0f);
+		for (int axis = 0; axis < 3; axis++)
+			out.position[axis] = (uint16_t)(unit[axis] * 65535.0f + 0.5f);
+		out.position[3] = 0;
+
+		out.normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+		out.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+		out.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+	}
+}
+
+Vertex unpackVertex(const PackedVertex& packed, const glm::mat4& dequantization)
+{
+	Vertex vertex;
+
+	glm::vec3 unit = glm::vec3(packed.position[0], packed.position[1], packed.position[2]) / 65535.0f;
+	vertex.Position = glm::vec3(dequantization * glm::vec4(unit, 1.0f));
+	// the GL 4.2 conversion, GL 3.3 drivers may use (2c + 1) / 1023 which differs by half a step
+	vertex.Normal = glm::vec3(glm::unpackSnorm3x10_1x2(packed.normal));
+	vertex.TexCoords = glm::vec2(glm::unpackHalf1x16(packed.texCoords[0]), glm::unpackHalf1x16(packed.texCoords[1]));
+
+	return vertex;
+}
@@ -0,0 +1,32 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// ---------------------------------------------------------------------------------------------- Packed Layout
+// 16 bytes instead of Vertex's 32. Positions are 16 bit unsigned normalized inside the mesh's box, the
+// box is put back by the matrix from dequantizationMatrix(), folded into the model matrix. Normals are
+// signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV) and texture coordinates half floats; neither
+// depends on the box, so normal matrices stay those of the model matrix alone.
+struct PackedVertex {
+	uint16_t position[4];	// w unused, keeps the normal 4 byte aligned
+	uint32_t normal;
+	uint16_t texCoords[2];
+};
+
+struct Vertex;
+
+// Maps the [0, 1] cube the positions are stored in onto the box. Flat axes keep a non-zero scale.
+glm::mat4 dequantizationMatrix(const AABB& bounds);
+
+void packVertices(const Vertex* vertices, size_t count, const AABB& bounds, PackedVertex* packed);
+// What the vertex shader sees for a packed vertex, with the dequantization applied. For checking
+// the precision on the CPU.
+Vertex unpackVertex(const PackedVertex& packed, const glm::mat4& dequantization);
+
+#endif //VERTEXFORMAT_H